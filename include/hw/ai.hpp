@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::ai {
 
 // AI I/O registers
@@ -27,6 +29,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 i64 getAICycles();
 
 bool isEnabled();
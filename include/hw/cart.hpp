@@ -0,0 +1,65 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+#include "sys/dma.hpp"
+#include "sys/savestate.hpp"
+
+namespace hw::cart {
+
+enum class SaveType {
+    Auto,
+    None,
+    EEPROM4K,
+    EEPROM16K,
+    SRAM,
+    FlashRAM,
+};
+
+// Overrides save type detection, has to be called before init
+void setSaveType(const SaveType type);
+
+// Parses a save type name as used on the command line, returns false if it's invalid
+bool parseSaveType(const char *name, SaveType &type);
+
+// Returns the save type in use, only valid after init
+SaveType getSaveType();
+
+const char *getSaveTypeName(const SaveType type);
+
+// Save data is stored next to the ROM
+void init(const char *romPath);
+void deinit();
+
+void reset();
+
+void doSavestate(sys::savestate::State &state);
+
+// EEPROM (Joybus channel 4)
+
+bool hasEEPROM();
+
+// Returns the Joybus device identifier of the EEPROM
+u16 getEEPROMIdentifier();
+
+// Reads/writes one 8-byte EEPROM block
+void readEEPROM(const u8 block, u8 *data);
+void writeEEPROM(const u8 block, const u8 *data);
+
+// SRAM/FlashRAM (PI domain 2)
+
+// Sets up the cartridge side of a PI DMA, returns false if nothing is mapped at cartaddr
+bool mapDMA(const u64 cartaddr, const bool isWrite, sys::dma::Transfer &transfer);
+
+// Has to be called after a PI DMA wrote len bytes to the cartridge
+void finishDMAWrite(const u64 cartaddr, const u64 len);
+
+u32 read(const u64 paddr);
+void write(const u64 paddr, const u32 data);
+
+}
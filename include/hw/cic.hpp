@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::cic {
 
 void init();
@@ -14,6 +16,17 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
+// Returns the IPL2/3 seeds as sent to PIF-NUS
+u64 getSeeds();
+
+// Number of nibbles in a CIC-NUS-6105 challenge/response
+constexpr u64 CHALLENGE_LENGTH = 30;
+
+// Computes the CIC-NUS-6105 response to a challenge, one nibble per byte
+void respondToChallenge(const u8 *challenge, u8 *response);
+
 void setDataIn(const u64 length);
 void setDataOut(const u64 data, const u64 length);
 
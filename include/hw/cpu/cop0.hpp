@@ -11,8 +11,31 @@
 
 #include "hw/cpu/cpu.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::cpu::cop0 {
 
+// COP0 registers
+namespace Register {
+    enum : u32 {
+        Index = 0,
+        EntryLo0 = 2,
+        EntryLo1 = 3,
+        PageMask = 5,
+        Count = 9,
+        EntryHi = 10,
+        Compare = 11,
+        Status = 12,
+        Cause = 13,
+        EPC = 14,
+        Config = 16,
+        WatchLo = 18,
+        WatchHi = 19,
+        TagLo = 28,
+        TagHi = 29,
+    };
+};
+
 namespace InterruptNumber {
     enum : u32 {
         External = 2,
@@ -25,6 +48,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 bool isCoprocessorUsable(const u32 coprocessor);
 bool isLargeFPURegisterFile();
 
@@ -56,4 +81,7 @@ void doInstruction(const Instruction instr);
 
 void incrementCount();
 
+// Advances Count by several cycles at once
+void addCount(const u64 cycles);
+
 }
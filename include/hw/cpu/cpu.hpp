@@ -9,8 +9,44 @@
 
 #include "common/types.hpp"
 
+#include "sys/memory.hpp"
+#include "sys/savestate.hpp"
+
 namespace hw::cpu {
 
+// CPU virtual memory ranges
+namespace AddressRangeBase {
+    enum : u64 {
+        KUSEG = 0,
+        KSEG0 = 0x80000000,
+        KSEG1 = 0xA0000000,
+        KSSEG = 0xC0000000,
+        KSEG3 = 0xE0000000,
+    };
+}
+
+namespace AddressRangeSize {
+    enum : u64 {
+        KUSEG = 0x80000000,
+        KSEG0 = 0x20000000,
+        KSEG1 = 0x20000000,
+        KSSEG = 0x20000000,
+        KSEG3 = 0x20000000,
+    };
+}
+
+// CPU general-purpose registers
+namespace Register {
+    enum {
+        R0, AT, V0, V1, A0, A1, A2, A3,
+        T0, T1, T2, T3, T4, T5, T6, T7,
+        S0, S1, S2, S3, S4, S5, S6, S7,
+        T8, T9, K0, K1, GP, SP, S8, RA,
+        LO, HI,
+        NumberOfRegisters,
+    };
+}
+
 namespace ExceptionCode {
     enum : u32 {
         Interrupt = 0x00,
@@ -62,8 +98,13 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 void raiseException(const u32 exceptionCode);
 
+// Prints the PC and all GPRs
+void dumpState();
+
 // Returns true if register index is valid
 bool isValidRegisterIndex(const u32 idx);
 
@@ -93,21 +134,48 @@ void branch(const u64 target, const bool condition, const u32 linkReg, const boo
 void advanceDelaySlot();
 void advancePC();
 
-u64 translateAddress(const u64 vaddr);
+// Error paths of the inline accessors below. Kept out of line so that loads and stores stay small
+[[noreturn, gnu::cold, gnu::noinline]] void unmappedAccess(const u64 vaddr);
+[[noreturn, gnu::cold, gnu::noinline]] void unalignedAccess(const u64 vaddr, const u64 size, const bool isWrite);
+
+inline u64 translateAddress(const u64 vaddr) {
+    // KSEG0 and KSEG1 are direct mapped, everything else goes through the TLB
+    const u32 vaddrMasked = vaddr;
+    if ((vaddrMasked < AddressRangeBase::KSEG0) || (vaddrMasked >= AddressRangeBase::KSSEG)) [[unlikely]] {
+        unmappedAccess(vaddr);
+    }
+
+    return vaddr & (AddressRangeSize::KSEG0 - 1);
+}
 
 // Reads data from memory. Does virtual address translation
 template<typename T>
-T read(const u64 vaddr) requires std::is_unsigned_v<T>;
+inline T read(const u64 vaddr) requires std::is_unsigned_v<T> {
+    if (!isAlignedAddress<T>(vaddr)) [[unlikely]] {
+        unalignedAccess(vaddr, sizeof(T), false);
+    }
+
+    return sys::memory::read<T>(translateAddress(vaddr));
+}
 
 // Fetches an instruction word, increments PC
 u32 fetch();
 
 // Writes data to memory. Does virtual address translation
 template<typename T>
-void write(const u64 vaddr, const T data) requires std::is_unsigned_v<T>;
+inline void write(const u64 vaddr, const T data) requires std::is_unsigned_v<T> {
+    if (!isAlignedAddress<T>(vaddr)) [[unlikely]] {
+        unalignedAccess(vaddr, sizeof(T), true);
+    }
+
+    return sys::memory::write(translateAddress(vaddr), data);
+}
 
 void doInstruction();
 
+// Runs a single instruction, never high-level emulated
+void step();
+
 void run(const i64 cycles);
 
 }
@@ -0,0 +1,24 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include <string>
+
+#include "common/types.hpp"
+
+namespace hw::cpu::disassembler {
+
+// Returns the assembly of the VR4300 instruction instr at pc, ".word" for anything unrecognized.
+// Doesn't touch emulator state, so it can be used by offline tools
+std::string disassemble(const u64 pc, const u32 instr);
+
+// Returns the GPR written by instr, or -1 if it doesn't write one. HI/LO aren't GPRs
+int getDestinationRegister(const u32 instr);
+
+// Returns the name of a GPR
+const char *getRegisterName(const u32 idx);
+
+}
@@ -11,6 +11,8 @@
 
 #include "hw/cpu/cpu.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::cpu::fpu {
 
 void init();
@@ -18,12 +20,16 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 bool getCondition();
 
-f32 makeSingle(const u32 data);
-f64 makeDouble(const u64 data); 
-u32 makeWord(const f32 data);
-u64 makeLong(const f64 data);
+// Has to be called whenever Status.FR changes
+void updateRegisterFile();
+
+// Switches the host FPU to the rounding/flush modes in FCR31 while the CPU runs, and back
+void enterGuest();
+void leaveGuest();
 
 // Returns the value of an FPU register
 template<typename T>
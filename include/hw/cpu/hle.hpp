@@ -0,0 +1,28 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+namespace hw::cpu::hle {
+
+void init();
+void deinit();
+
+void reset();
+
+// Replaces known libultra routines with native implementations
+void setEnabled(const bool isEnabled);
+bool isEnabled();
+
+// Returns the name of the routine starting at pc, NULL if there is none
+const char *getRoutineName(const u64 pc);
+
+// Runs the native implementation of the routine starting at pc, if there is one.
+// Returns the number of cycles the routine would have taken, or 0 if the guest code has to run
+i64 tryCall(const u64 pc);
+
+}
@@ -0,0 +1,21 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+namespace hw::cpu::lockstep {
+
+// Runs every high-level emulated routine through the interpreter as well, starting from the same machine state,
+// and stops at the first call where the two disagree. Execution continues with the interpreter's results
+void setEnabled(const bool isEnabled);
+bool isEnabled();
+
+// Checks the routine starting at pc, if there is one.
+// Returns the number of instructions the interpreter ran, or 0 if there is no routine at pc
+i64 tryCall(const u64 pc);
+
+}
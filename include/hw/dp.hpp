@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::dp {
 
 // SP I/O registers
@@ -25,6 +27,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 u32 readIO(const u64 ioaddr);
 
 void writeIO(const u64 ioaddr, const u32 data);
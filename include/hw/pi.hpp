@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::pi {
 
 // PI I/O registers
@@ -15,6 +17,7 @@ namespace IORegister {
         IOBase = 0x4600000,
         DRAMADDR = IOBase + 0x00,
         CARTADDR = IOBase + 0x04,
+        RDLEN = IOBase + 0x08,
         WRLEN = IOBase + 0x0C,
         STATUS = IOBase + 0x10,
         BSDDOM1LAT = IOBase + 0x14,
@@ -33,7 +36,14 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
+// Defers copying large cartridge DMAs until RDRAM is accessed
+void setLazyDMA(const bool isEnabled);
+
+void doDMAToCart();
 void doDMAToRAM();
+void finishDMA();
 
 u32 readIO(const u64 ioaddr);
 
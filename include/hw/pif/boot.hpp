@@ -0,0 +1,15 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+namespace hw::pif::boot {
+
+// High-level emulates the boot ROM and IPL3, leaves the system at the game's entry point
+void run();
+
+}
@@ -7,12 +7,34 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::pif::joybus {
 
+constexpr u8 NUM_CHANNELS = 5;
+
+// Channels 0-3 are controller ports
+constexpr u8 MAX_CONTROLLERS = 4;
+
+// Returned by runCommand, set in the RX length byte of a command block
+namespace TransferStatus {
+    enum : u8 {
+        OK = 0,
+        Error = 1 << 6,
+        NoResponse = 1 << 7,
+    };
+}
+
+// Sets the number of connected controllers, has to be called before init
+void setControllerNum(const int num);
+int getControllerNum();
+
 void init();
 void deinit();
 
 void reset();
+
+void doSavestate(sys::savestate::State &state);
 void resetTXBuffer();
 
 void prepareReceiveData(const u8 length);
@@ -23,10 +45,19 @@ u8 calculateCRC(const u8 *data);
 
 void doCommand();
 
-void cmdControllerState();
-void cmdInfo();
-void cmdReadControllerAccessory();
-void cmdWriteControllerAccessory();
+// Resets the device on channel
+void resetChannel(const u8 channel);
+
+// Runs a complete Joybus transaction, returns its TransferStatus
+u8 runCommand(const u8 channel, const u8 *tx, const u8 txLength, u8 *rx, const u8 rxLength);
+
+// Return false if the device on the active channel doesn't respond to the command
+bool cmdControllerState();
+bool cmdInfo();
+bool cmdReadControllerAccessory();
+bool cmdReadEEPROM();
+bool cmdWriteControllerAccessory();
+bool cmdWriteEEPROM();
 
 u8 readChannel();
 u8 readError();
@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::pif::memory {
 
 namespace MemoryBase {
@@ -27,6 +29,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 u8 read(const u16 paddr);
 u8 readRAM(const u8 paddr);
 
@@ -0,0 +1,52 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+#include "sys/savestate.hpp"
+
+namespace hw::pif::pak {
+
+// Size of one accessory read/write
+constexpr u64 BLOCK_SIZE = 32;
+
+enum class PakType {
+    None,
+    ControllerPak,
+    RumblePak,
+};
+
+// Selects the accessory plugged into every controller, has to be called before init
+void setPakType(const PakType type);
+PakType getPakType();
+
+// Parses a pak type name as used on the command line, returns false if it's invalid
+bool parsePakType(const char *name, PakType &type);
+
+const char *getPakTypeName(const PakType type);
+
+// Controller Pak data is stored next to the ROM
+void init(const char *romPath);
+void deinit();
+
+void reset();
+
+// Resets the accessory on channel, stopping the Rumble Pak motor
+void resetPak(const u8 channel);
+
+void doSavestate(sys::savestate::State &state);
+
+bool isInserted(const u8 channel);
+
+// Returns true if the 5-bit CRC in addr matches the block address
+bool isAddressValid(const u16 addr);
+
+// Reads/writes one 32-byte block. addr includes the address CRC
+void readBlock(const u8 channel, const u16 addr, u8 *data);
+void writeBlock(const u8 channel, const u16 addr, const u8 *data);
+
+}
@@ -9,13 +9,50 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::pif {
 
-void init();
+// PIF RAM locations, not an enum since they get added to MemoryBase addresses
+namespace RAMOffset {
+    constexpr u64 CICSeeds = 0x24;
+    constexpr u64 ChallengeStatus = 0x2E;
+    constexpr u64 Challenge = 0x30;
+    constexpr u64 Command = 0x3C;
+}
+
+// PIF RAM command bits
+namespace Command {
+    enum : u32 {
+        RunJoybus = 1 << 0,
+        ChallengeCIC = 1 << 1,
+        TerminateBoot = 1 << 3,
+        LockBootROM = 1 << 4,
+        AcquireChecksum = 1 << 5,
+        ClearRAM = 1 << 6,
+        ChecksumAcquired = 1 << 7,
+    };
+}
+
+void init(const bool useHLE);
 void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
+// Returns true if PIF-NUS is high-level emulated
+bool isHLE();
+
+// Returns a pointer to the 64 bytes of PIF RAM
+u8 *getRAM();
+
+// Executes the command in PIF RAM (HLE only)
+void processCommands();
+
+void wake();
+void runPIFNUS();
+
 void setInterruptAPending();
 
 void setRCPPort(const bool isRead, const bool is64B);
@@ -27,6 +64,7 @@ T read(const u64 paddr) requires std::is_unsigned_v<T>;
 // Writes data to PIF RAM
 void write(const u64 paddr, const u32 data);
 
+// Runs PIF-NUS for a number of CPU cycles outside of the scheduler
 void run(const i64 cycles);
 
 }
@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::rdp::rasterizer {
 
 union SetCombineModeHeader {
@@ -83,6 +85,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 template<u64 size>
 u64 readTMEM(const u64 tmemAddr, const u64 x, const u64 y, const u64 width);
 
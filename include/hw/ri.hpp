@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::ri {
 
 // RI I/O registers
@@ -38,6 +40,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 u64 getRDRAMAddress(const u64 ioaddr);
 
 u32 readIO(const u64 ioaddr);
@@ -0,0 +1,90 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+#include "common/types.hpp"
+
+#include "sys/dma.hpp"
+
+namespace hw::rsp::capture {
+
+// RSP task capture. A task runs from the RSP being unhalted until it halts again.
+// Its inputs are everything the RSP can observe: RSP, SP and DP state, IMEM, DMEM and every RDRAM page
+// the task accesses through DMA (as it was on first access). Outputs are hashed, so the capture stays small.
+// Pages are only copied once per task: if the CPU rewrites a page the task already read and the task
+// reads it again, the replay sees the old contents and reports the task's outputs as different
+
+namespace OutputType {
+    enum : u32 {
+        DMAToRAM,
+        DPCommands,
+    };
+}
+
+struct Output {
+    u32 type;
+
+    u64 addr;
+    u64 size;
+    u64 hash;
+};
+
+struct Page {
+    u64 addr;
+
+    std::vector<u8> data;
+};
+
+struct Task {
+    // RSP, SP and DP state, IMEM and DMEM
+    std::vector<u8> state;
+
+    std::vector<Page> pages;
+
+    std::vector<Output> outputs;
+
+    // DMEM after the task halted
+    std::vector<u8> dmem;
+};
+
+// Captures every RSP task to path, has to be called before init
+void setPath(const char *path);
+
+void init();
+void deinit();
+
+bool isReplaying();
+
+// Called by SP whenever the RSP gets unhalted/halted
+void startTask();
+void finishTask();
+
+// Called by SP before an RSP DMA, and after a DMA to RDRAM has been copied
+void beforeDMA(const sys::dma::Transfer &transfer);
+void afterDMAToRAM(const sys::dma::Transfer &transfer);
+
+// Called by DP before a command list is processed
+void onDPCommands(const u64 startAddr, const u64 endAddr);
+
+// Replay. Used by satou64_rsp_replay
+
+// Reads the file header, returns false if file isn't a task capture
+bool readHeader(FILE *file);
+
+// Reads the next task, returns false at the end of the file
+bool readTask(FILE *file, Task &task);
+
+// Restores the machine to the start of task and starts recording its outputs.
+// Returns false if the task's state is corrupt
+bool startReplay(const Task &task);
+
+// Returns the replayed task once the RSP has halted
+const Task &getReplayResult();
+
+}
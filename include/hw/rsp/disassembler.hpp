@@ -0,0 +1,21 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include <string>
+
+#include "common/types.hpp"
+
+namespace hw::rsp::disassembler {
+
+// Returns the assembly of the RSP instruction instr at IMEM address pc.
+// Scalar instructions are shared with the VR4300 disassembler
+std::string disassemble(const u32 pc, const u32 instr);
+
+// Returns the GPR written by instr, or -1 if it doesn't write one
+int getDestinationRegister(const u32 instr);
+
+}
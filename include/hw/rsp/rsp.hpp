@@ -9,6 +9,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::rsp {
 
 union VUInstruction {
@@ -38,6 +40,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 // Returns true if register index is valid
 bool isValidRegisterIndex(const u32 idx);
 
@@ -69,6 +73,7 @@ void VXOR(const VUInstruction instr);
 
 void doInstruction();
 
-void run(const i64 cycles);
+// Returns the number of instructions executed, fewer than cycles if the RSP halted
+i64 run(const i64 cycles);
 
 }
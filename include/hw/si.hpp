@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::si {
 
 // SI I/O registers
@@ -25,9 +27,16 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 void startDMAFromPIF();
 void startDMAToPIF();
 
+void transferFromPIF();
+void transferToPIF();
+
+void finishDMA();
+
 void doDMAFromPIF();
 void doDMAToPIF();
 
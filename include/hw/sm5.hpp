@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::sm5 {
 
 constexpr u64 STACK_DEPTH = 4;
@@ -172,6 +174,11 @@ public:
 
     void reset();
 
+    void doSavestate(sys::savestate::State &state);
+
+    // Returns true if the SM5 is waiting for an interrupt
+    bool isInStandby() const;
+
     void setInterruptAPending();
 
     void setRCPPort(const bool isRead, const bool is64B);
@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::sp {
 
 // SP I/O registers
@@ -30,12 +32,16 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 void BREAK();
 
 bool isHalted();
+bool isDMABusy();
 
 void doDMAToRAM();
 void doDMAToRSP();
+void finishDMA();
 
 u32 readIO(const u64 ioaddr);
 
@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace hw::vi {
 
 // VI I/O registers
@@ -35,6 +37,8 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
 u32 readIO(const u64 ioaddr);
 
 u32 getFormat();
@@ -0,0 +1,30 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+namespace renderer::overlay {
+
+// The overlay covers the top-left corner of the first HEIGHT scanlines
+constexpr u32 WIDTH = 128;
+constexpr u32 HEIGHT = 52;
+
+void init();
+void deinit();
+
+void setEnabled(const bool isEnabled);
+bool isEnabled();
+
+void toggle();
+
+// Called once per presented frame, samples timings and redraws the overlay
+void update();
+
+// Composites the overlay over the first HEIGHT scanlines of src into dst. Both are RGBX8888, width pixels wide
+void compose(const u32 *src, u32 *dst, const u32 width);
+
+}
@@ -7,6 +7,8 @@
 
 #include "../common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace sys::audio {
 
 void init();
@@ -14,6 +16,14 @@ void deinit();
 
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
+// Drops generated samples while muted, used when emulating frames that are thrown away
+void setMuted(const bool isMuted);
+
+// Returns how full the sample buffer is, from 0 to 1
+double getBufferFill();
+
 void audioCallback(void *userData, u8 *buffer, int length);
 void pushSamples(const i16 left, const i16 right);
 
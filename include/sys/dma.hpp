@@ -0,0 +1,37 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+namespace sys::dma {
+
+// A DMA between RDRAM and a device-local memory (cartridge, RSP memory, PIF RAM).
+// Transfers are made of count rows of length bytes, RDRAM advances by length + skip bytes per row.
+// Local memory wraps around at localSize if isLocalWrapping is set, reads past its end return 0
+struct Transfer {
+    u64 dramaddr;
+
+    u8 *local;
+    u64 localAddr;
+    u64 localSize;
+
+    u64 length;
+    u64 count;
+    u64 skip;
+
+    bool isLocalWrapping;
+};
+
+// Runs a transfer in as few host memory copies as possible, marks written RDRAM pages dirty.
+// Both sides are stored in big-endian byte order, so no byteswapping is needed
+void copyToRDRAM(const Transfer &transfer);
+void copyFromRDRAM(const Transfer &transfer);
+
+// Returns the final RDRAM address of a transfer
+u64 getEndAddress(const Transfer &transfer);
+
+}
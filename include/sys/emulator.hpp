@@ -7,6 +7,8 @@
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace sys::emulator {
 
 void init(const char *bootPath, const char *pifPath, const char *romPath);
@@ -14,11 +16,25 @@ void deinit();
 
 void run();
 
+// True if the boot ROM and IPL3 are skipped
+bool usesFastBoot();
+
+// Number of frames to emulate ahead of the presented frame, 0 disables run-ahead
+void setRunAheadFrames(const int frames);
+
+// Keeps a per-frame rewind history, off by default
+void setRewindEnabled(const bool isEnabled);
+
 void reset();
 
+void doSavestate(sys::savestate::State &state);
+
+// Samples the keyboard, returns the current controller button state
 u32 getButtonState();
 
 void finishFrame();
+
+void pollEvents();
 void updateButtonState();
 
 }
@@ -5,10 +5,14 @@
 
 #pragma once
 
+#include <array>
+#include <cstring>
 #include <type_traits>
 
 #include "common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace sys::memory {
 
 // Constants for software fastmem
@@ -23,6 +27,7 @@ namespace MemoryBase {
         RDRAM = 0,
         RSP_DMEM = 0x4000000,
         RSP_IMEM = 0x4001000,
+        CART_DOM2_A2 = 0x8000000,
         CART_DOM1_A2 = 0x10000000,
         PIF_ROM = 0x1FC00000,
         PIF_RAM = 0x1FC007C0,
@@ -41,33 +46,180 @@ namespace MemorySize {
     };
 }
 
+constexpr u64 NUM_RDRAM_PAGES = MemorySize::RDRAM >> PAGE_SHIFT;
+
+// The page table has two levels. Every 1 MiB region of the physical address space has a table of
+// page pointers, regions without any mapped memory all share one table that maps nothing
+
+constexpr u32 REGION_SHIFT = 20;
+constexpr u64 NUM_REGIONS = MemorySize::AddressSpace >> REGION_SHIFT;
+constexpr u64 PAGES_PER_REGION = 1 << (REGION_SHIFT - PAGE_SHIFT);
+
+using RegionTable = std::array<u8 *, PAGES_PER_REGION>;
+
+// Only the inline fast paths below should touch these directly
+
+// Page table for software fastmem
+extern std::array<RegionTable *, NUM_REGIONS> pageTable;
+
+// RDRAM dirty tracking, a page is dirty relative to a cursor if its stamp is newer
+extern std::array<u64, NUM_RDRAM_PAGES> pageGenerations;
+
+extern u64 generation;
+
+// romPath can be NULL for tools that run without a cartridge
 void init(const char *bootPath, const char *romPath);
 void deinit();
 
 void reset();
 
-u64 addressToPage(const u64 addr);
+void doSavestate(sys::savestate::State &state);
+
+constexpr u64 addressToPage(const u64 addr) {
+    return addr >> PAGE_SHIFT;
+}
+
 constexpr u64 addressToIOPage(const u64 addr);
-u64 pageToAddress(const u64 page);
+
+constexpr u64 pageToAddress(const u64 page) {
+    return page << PAGE_SHIFT;
+}
 
 // Returns true if address is a valid physical address
-bool isValidPhysicalAddress(const u64 paddr);
+constexpr bool isValidPhysicalAddress(const u64 paddr) {
+    return paddr < MemorySize::AddressSpace;
+}
+
+// Returns the host memory a page is mapped to, NULL if it's unmapped
+inline u8 *getPage(const u64 page) {
+    return (*pageTable[page >> (REGION_SHIFT - PAGE_SHIFT)])[page & (PAGES_PER_REGION - 1)];
+}
 
 // Maps memory into software fastmem page table
 void map(const u64 paddr, const u64 size, u8 *mem);
 
+u64 getROMSize();
+
 u8 *getPointer(const u64 paddr);
 
+// Lazy DMA. Full RDRAM pages of a lazy copy are unmapped and only copied on first access through read()/write().
+// Anything that accesses RDRAM through getPointer() has to materialize the range first
+
+// Copies size bytes from src to RDRAM. src has to stay valid until the copy is materialized
+void copyLazy(const u64 paddr, const u8 *src, const u64 size);
+
+// Returns true if page had a pending lazy copy
+bool materializeLazyPage(const u64 page);
+
+void materialize(const u64 paddr, const u64 size);
+void materializeAll();
+
+// Snapshots (save states, run-ahead, rewind) keep pending pages lazy instead of materializing them
+
+// Returns the source of page's pending lazy copy, NULL if there is none
+const u8 *getLazySource(const u64 page);
+
+// Returns what an RDRAM page holds without materializing it
+const u8 *getPageContents(const u64 page);
+
+// Makes page a pending lazy copy of src, or drops its pending copy without copying if src is NULL.
+// In that case the caller has to overwrite the whole page
+void setLazyPage(const u64 page, const u8 *src);
+
+// RDRAM dirty tracking. Every 4 KiB page is stamped with the generation it was last written in.
+// Clients hold their own cursors and ask which pages were written after the cursor was taken
+
+// Marks RDRAM written by anything that doesn't go through write(), e.g. DMAs
+void markDirty(const u64 paddr, const u64 size);
+
+// Returns a new cursor, pages written after this call are dirty relative to it
+u64 advanceGeneration();
+
+bool isPageDirty(const u64 page, const u64 cursor);
+bool isRangeDirty(const u64 paddr, const u64 size, const u64 cursor);
+
+// Watchpoints. Watched pages are taken out of the page table, so only accesses to them pay for the checks.
+// Accesses through getPointer() (DMAs) are not reported
+
+void watchPage(const u64 page);
+void unwatchPage(const u64 page);
+
+// For code that bypasses the page table and has to fall back to guest accesses on watched pages
+bool isPageWatched(const u64 page);
+bool isRangeWatched(const u64 paddr, const u64 size);
+
+// Called on every store, has to stay cheap
+inline void stampPage(const u64 page) {
+    if (page < NUM_RDRAM_PAGES) {
+        pageGenerations[page] = generation;
+    }
+}
+
+// Handles everything that isn't mapped into the page table: lazy DMA pages, PIF, cartridge saves and I/O.
+// Kept out of line so that the fast paths stay small enough to inline into every caller
+template<typename T>
+[[gnu::cold, gnu::noinline]] T readSlow(const u64 paddr) requires std::is_unsigned_v<T>;
+
+template<typename T>
+[[gnu::cold, gnu::noinline]] void writeSlow(const u64 paddr, const T data) requires std::is_unsigned_v<T>;
+
+[[gnu::cold, gnu::noinline]] u32 fetchSlow(const u64 paddr);
+
 // Reads data from system memory
 template<typename T>
-T read(const u64 paddr) requires std::is_unsigned_v<T>;
+inline T read(const u64 paddr) requires std::is_unsigned_v<T> {
+    if (isValidPhysicalAddress(paddr)) [[likely]] {
+        const u8 *mem = getPage(addressToPage(paddr));
+
+        if (mem != NULL) [[likely]] {
+            T data;
+            std::memcpy(&data, &mem[paddr & PAGE_MASK], sizeof(T));
+
+            return byteswap(data);
+        }
+    }
+
+    return readSlow<T>(paddr);
+}
 
 // Reads data from the I/O bus
 u32 readIO(const u64 ioaddr);
 
+// Reads an instruction word. Same as read<u32>(), except that watched pages report an execute access
+inline u32 fetch(const u64 paddr) {
+    if (isValidPhysicalAddress(paddr)) [[likely]] {
+        const u8 *mem = getPage(addressToPage(paddr));
+
+        if (mem != NULL) [[likely]] {
+            u32 data;
+            std::memcpy(&data, &mem[paddr & PAGE_MASK], sizeof(u32));
+
+            return byteswap(data);
+        }
+    }
+
+    return fetchSlow(paddr);
+}
+
 // Writes data to system memory
 template<typename T>
-void write(const u64 paddr, const T data) requires std::is_unsigned_v<T>;
+inline void write(const u64 paddr, const T data) requires std::is_unsigned_v<T> {
+    if (isValidPhysicalAddress(paddr)) [[likely]] {
+        const u64 page = addressToPage(paddr);
+
+        u8 *mem = getPage(page);
+
+        if (mem != NULL) [[likely]] {
+            const T swappedData = byteswap(data);
+            std::memcpy(&mem[paddr & PAGE_MASK], &swappedData, sizeof(T));
+
+            stampPage(page);
+            return;
+        }
+    }
+
+    return writeSlow(paddr, data);
+}
 
 // Writes data to the I/O bus
 void writeIO(const u64 ioaddr, const u32 data);
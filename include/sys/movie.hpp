@@ -0,0 +1,30 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+#include "sys/savestate.hpp"
+
+namespace sys::movie {
+
+void init();
+void deinit();
+
+void reset();
+
+void doSavestate(sys::savestate::State &state);
+
+// Records every controller poll from power-on, written to path on deinit
+void startRecording(const char *path);
+
+// Replaces controller input with a recording made from power-on
+void startPlayback(const char *path);
+
+// Called on every controller poll, returns the button state the game sees
+u32 pollController(const u32 buttonState);
+
+}
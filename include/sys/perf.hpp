@@ -0,0 +1,68 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+namespace sys::perf {
+
+// Parts of the emulator host counters are attributed to. Phases nest, the innermost one gets the counts
+namespace Phase {
+    enum : u32 {
+        Other,
+        CPU,
+        RSP,
+        PIF,
+        Scheduler,
+        RDP,
+        Present,
+        NumberOfPhases,
+    };
+}
+
+// Reads host hardware counters with perf_event_open (Linux only), has to be called before init
+void setEnabled(const bool isEnabled);
+
+// Measures host time per phase for takeFrameTimes, can be toggled at any time
+void setTimingEnabled(const bool isEnabled);
+
+// Returns the host time spent in every phase since the last call, in seconds
+void takeFrameTimes(double (&times)[Phase::NumberOfPhases]);
+
+void init();
+
+// Prints cycles, IPC and miss rates per phase
+void deinit();
+
+// True if counters are being read or phases are being timed
+extern bool isActive;
+
+void enter(const u32 phase);
+void leave();
+
+// Attributes host counters to phase for as long as it's alive
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const u32 phase) : isEntered(isActive) {
+        if (isEntered) {
+            enter(phase);
+        }
+    }
+
+    ~ScopedPhase() {
+        if (isEntered) {
+            leave();
+        }
+    }
+
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+private:
+    bool isEntered;
+};
+
+}
@@ -0,0 +1,23 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+namespace sys::rewind {
+
+void init();
+void deinit();
+
+void reset();
+
+// Records the current machine state, should be called once per frame
+void pushCheckpoint();
+
+// Restores the most recent checkpoint and drops it. Returns false if the history is empty
+bool popCheckpoint();
+
+}
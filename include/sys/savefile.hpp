@@ -0,0 +1,41 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+#include "sys/savestate.hpp"
+
+namespace sys::savefile {
+
+// A memory-mapped save file. Writes go straight to the page cache, so they survive the emulator crashing.
+// A background thread writes dirty pages back to disk once they haven't been touched for a while
+struct SaveFile;
+
+void init();
+void deinit();
+
+void reset();
+
+// Maps a save file of size bytes, creating it (filled with fill) if it doesn't exist yet
+SaveFile *open(const char *path, const u64 size, const u8 fill);
+
+// Writes back and unmaps a save file, file can't be used afterwards
+void close(SaveFile *file);
+
+u8 *getData(SaveFile *file);
+
+// Returns an FNV-1a hash of every open save file's data, in the order they were opened
+u64 hashData();
+
+// Has to be called after modifying the save file's data
+void markDirty(SaveFile *file, const u64 offset, const u64 size);
+
+// Saves/loads the file's data if the state has StateFlag::SaveData, file can be NULL.
+// Loaded data only gets written back if it differs, so restoring snapshots every frame doesn't keep the file dirty
+void doSavestate(sys::savestate::State &state, SaveFile *file);
+
+}
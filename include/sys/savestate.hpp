@@ -0,0 +1,79 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include <type_traits>
+#include <vector>
+
+#include "common/types.hpp"
+
+namespace sys::savestate {
+
+// Optional parts of a save state
+namespace StateFlag {
+    enum : u32 {
+        None = 0,
+        RDRAM = 1 << 0,
+        Audio = 1 << 1,
+        SaveData = 1 << 2,
+        All = RDRAM | Audio | SaveData,
+    };
+}
+
+// Serializes or deserializes machine state, depending on how it was constructed
+struct State {
+private:
+    std::vector<u8> *saveBuffer;
+
+    const u8 *loadData;
+    u64 loadSize;
+
+    u64 offset;
+
+    u32 flags;
+
+    bool isOverrun;
+
+public:
+    // Creates a state that appends to buffer
+    State(std::vector<u8> &buffer, const u32 flags);
+
+    // Creates a state that reads from data
+    State(const u8 *data, const u64 size, const u32 flags);
+
+    bool isLoading() const;
+    bool isValid() const;
+
+    // Returns the number of bytes processed so far
+    u64 getSize() const;
+
+    // Marks loaded data as corrupt
+    void invalidate();
+
+    bool hasFlag(const u32 flag) const;
+
+    void doBytes(void *data, const u64 size);
+
+    template<typename T>
+    void doPOD(T &data) requires std::is_trivially_copyable_v<T> {
+        doBytes(&data, sizeof(T));
+    }
+};
+
+void init();
+void deinit();
+
+void reset();
+
+// Saves/loads the entire machine to/from a file
+bool save(const char *path);
+bool load(const char *path);
+
+// Saves/loads machine state to/from memory
+void saveToBuffer(std::vector<u8> &buffer, const u32 flags);
+bool loadFromBuffer(const std::vector<u8> &buffer, const u32 flags);
+
+}
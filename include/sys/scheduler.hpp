@@ -9,6 +9,8 @@
 
 #include "../common/types.hpp"
 
+#include "sys/savestate.hpp"
+
 namespace sys::scheduler {
 
 constexpr i64 CPU_FREQUENCY = 93750000;
@@ -18,7 +20,12 @@ void deinit();
 
 void reset();
 
-u64 registerEvent(const std::function<void(int)> func);
+void doSavestate(sys::savestate::State &state);
+
+// Registers an event, returns event ID. name is used for statistics
+u64 registerEvent(const char *name, const std::function<void(int)> func);
+
+const char *getEventName(const u64 id);
 
 void addEvent(const u64 id, const int param, const i64 cycles);
 
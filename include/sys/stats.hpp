@@ -0,0 +1,93 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include "common/types.hpp"
+
+#include "hw/mi.hpp"
+
+namespace sys::stats {
+
+namespace DMAEngine {
+    enum : u32 {
+        AI,
+        PI,
+        SI,
+        SP,
+        NumberOfEngines,
+    };
+}
+
+namespace IODevice {
+    enum : u32 {
+        RDRAM,
+        SP,
+        DP,
+        MI,
+        VI,
+        AI,
+        PI,
+        RI,
+        SI,
+        NumberOfDevices,
+    };
+}
+
+constexpr u64 MAX_EXCEPTION_CODES = 32;
+constexpr u64 MAX_EVENT_TYPES = 16;
+constexpr u64 MAX_RDP_COMMANDS = 64;
+
+// Everything counted during one VI frame
+struct Counters {
+    u64 cpuInstructions;
+    u64 rspInstructions;
+
+    // By exception code and MI interrupt source
+    u64 exceptions[MAX_EXCEPTION_CODES];
+    u64 interrupts[hw::mi::InterruptSource::NumberOfInterruptSources];
+
+    // By scheduler event ID
+    u64 events[MAX_EVENT_TYPES];
+
+    u64 dmas[DMAEngine::NumberOfEngines];
+    u64 dmaBytes[DMAEngine::NumberOfEngines];
+
+    u64 ioAccesses[IODevice::NumberOfDevices];
+
+    // By command ID
+    u64 rdpCommands[MAX_RDP_COMMANDS];
+
+    u64 pixels;
+    u64 texels;
+};
+
+// Counters of the current frame. Every thread counts into its own copy with plain increments,
+// so counting costs about as much as an add
+extern thread_local Counters counters;
+
+void init();
+void deinit();
+
+void reset();
+
+// Called by the emulation thread at the end of every VI frame.
+// Publishes its counters as the last frame's and clears them
+void onFrame();
+
+// Returns the counters of the last finished frame, can be called from any thread
+Counters getLastFrame();
+
+u64 getFrameNum();
+
+const char *getDMAEngineName(const u32 engine);
+const char *getIODeviceName(const u32 device);
+
+inline void countDMA(const u32 engine, const u64 bytes) {
+    counters.dmas[engine]++;
+    counters.dmaBytes[engine] += bytes;
+}
+
+}
@@ -0,0 +1,69 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "common/types.hpp"
+
+namespace sys::trace {
+
+namespace Core {
+    enum : u32 {
+        CPU,
+        RSP,
+        NumberOfCores,
+    };
+}
+
+// One executed instruction
+struct Record {
+    u32 pc;
+    u32 instr;
+
+    // Value of the GPR the instruction wrote, 0 if it didn't write one
+    u64 value;
+};
+
+using Records = std::array<std::vector<Record>, Core::NumberOfCores>;
+
+// Enables tracing, the last records of every core are written to path on deinit or exit
+void setPath(const char *path);
+
+// Selects the traced cores (1 << Core::CPU etc.), all cores by default
+void setCores(const u32 coreMask);
+
+// Parses a core list as used on the command line ("cpu", "rsp" or "all"), returns false if it's invalid
+bool parseCores(const char *name, u32 &coreMask);
+
+// Only records instructions in [start, end]. PCs are compared in each core's own address space
+void setPCRange(const u32 start, const u32 end);
+
+// Parses a PC range as used on the command line ("start:end"), returns false if it's invalid
+bool parsePCRange(const char *spec, u32 &start, u32 &end);
+
+// Starts recording once frame N has been reached
+void setStartFrame(const u64 frame);
+
+void init();
+void deinit();
+
+// Pauses/resumes recording
+void toggle();
+
+// Called at the end of every frame
+void onFrame();
+
+// Returns true if instructions of core should be recorded. Checked once per run slice
+bool isActive(const u32 core);
+
+void record(const u32 core, const u32 pc, const u32 instr, const u64 value);
+
+// Reads a trace written by deinit, returns false if it's invalid
+bool read(const char *path, Records &records);
+
+}
@@ -0,0 +1,55 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "common/types.hpp"
+
+namespace sys::watchpoint {
+
+namespace AccessType {
+    enum : u32 {
+        Read = 1 << 0,
+        Write = 1 << 1,
+        Execute = 1 << 2,
+    };
+}
+
+struct Hit {
+    u64 id;
+
+    // The access that triggered the watchpoint
+    u64 paddr;
+    u64 size;
+    u32 accessType;
+
+    u64 pc;
+};
+
+using Callback = std::function<void(const Hit &)>;
+
+// Watched pages are redirected in init, watchpoints can be added before that
+void init();
+void deinit();
+
+// Watches [paddr, paddr + size) for the given access types. Returns an ID for remove()
+u64 add(const u64 paddr, const u64 size, const u32 accessTypes);
+void remove(const u64 id);
+
+// Parses a watchpoint as used on the command line ("rwx:address[:size]"), returns false if it's invalid
+bool parseWatchpoint(const char *spec, u64 &paddr, u64 &size, u32 &accessTypes);
+
+// Called on every hit. Hits are printed if no callback is set
+void setCallback(const Callback func);
+
+// Prints the CPU state after every hit
+void setDumpState(const bool isEnabled);
+
+// Called by sys::memory for every access to a watched page
+void check(const u64 paddr, const u64 size, const u32 accessType);
+
+}
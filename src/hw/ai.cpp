@@ -16,6 +16,7 @@
 
 #include "sys/memory.hpp"
 #include "sys/scheduler.hpp"
+#include "sys/stats.hpp"
 
 namespace hw::ai {
 
@@ -94,7 +95,7 @@ u32 activeDMAs;
 u64 idDoSample;
 
 void init() {
-    idDoSample = sys::scheduler::registerEvent([](int) { doSample(); });
+    idDoSample = sys::scheduler::registerEvent("AI sample", [](int) { doSample(); });
 }
 
 void deinit() {}
@@ -105,6 +106,11 @@ void reset() {
     activeDMAs = 0;
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+    state.doPOD(activeDMAs);
+}
+
 // Taken from https://github.com/Dillonb/n64/blob/ad5924d02b6c218b3769c1c2cf4748f177c9eacd/src/interface/ai.c#L30
 i64 getAICycles() {
     return std::max(1LL, sys::scheduler::CPU_FREQUENCY / 4 / (regs.dacrate.dacRate + 1)) * 1.037;
@@ -155,6 +161,8 @@ void writeIO(const u64 ioaddr, const u32 data) {
             if ((activeDMAs < 2) && (data != 0)) {
                 regs.length[activeDMAs].raw = data;
 
+                sys::stats::countDMA(sys::stats::DMAEngine::AI, 8 * regs.length[activeDMAs].length);
+
                 activeDMAs++;
 
                 if ((activeDMAs == 1) && regs.control.dmaEnable) {
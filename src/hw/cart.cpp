@@ -0,0 +1,484 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/cart.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <ios>
+#include <string>
+
+#include <plog/Log.h>
+
+#include "sys/memory.hpp"
+#include "sys/savefile.hpp"
+
+namespace hw::cart {
+
+// Save memory sizes
+namespace SaveSize {
+    enum : u64 {
+        EEPROM4K = 0x200,
+        EEPROM16K = 0x800,
+        SRAM = 0x8000,
+        FlashRAM = 0x20000,
+    };
+}
+
+constexpr u64 EEPROM_BLOCK_SIZE = 8;
+
+namespace EEPROMIdentifier {
+    enum : u16 {
+        EEPROM4K = 0x0080,
+        EEPROM16K = 0x00C0,
+    };
+}
+
+// PI domain 2 addresses
+namespace Domain2Address {
+    enum : u64 {
+        Base = 0x08000000,
+        FlashStatus = Base + 0x00000,
+        FlashCommand = Base + 0x10000,
+        End = 0x10000000,
+    };
+}
+
+constexpr u64 FLASH_PAGE_SIZE = 128;
+constexpr u64 FLASH_SECTOR_SIZE = 128 * FLASH_PAGE_SIZE;
+
+// Macronix MX29L1101 silicon ID
+constexpr u8 FLASH_ID[] = {0x11, 0x11, 0x80, 0x01, 0x00, 0xC2, 0x00, 0x1E};
+
+// Top byte of a FlashRAM command
+namespace FlashCommand {
+    enum : u8 {
+        ChipEraseMode = 0x3C,
+        SectorEraseMode = 0x4B,
+        Erase = 0x78,
+        WriteArray = 0xA5,
+        WriteBufferMode = 0xB4,
+        StatusMode = 0xD2,
+        IDMode = 0xE1,
+        ReadMode = 0xF0,
+    };
+}
+
+namespace FlashStatus {
+    enum : u8 {
+        WriteDone = 1 << 2,
+        EraseDone = 1 << 3,
+    };
+}
+
+enum class FlashMode {
+    Read,
+    Status,
+    ID,
+    ChipErase,
+    SectorErase,
+    WriteBuffer,
+};
+
+struct FlashState {
+    FlashMode mode;
+
+    u8 status;
+
+    u64 eraseOffset;
+
+    u8 pageBuffer[FLASH_PAGE_SIZE];
+
+    // Status/ID as seen by DMAs
+    u8 statusBuffer[8];
+};
+
+// Game codes of some well-known titles, used when the ROM doesn't declare a save type
+struct KnownGame {
+    char id[3];
+    SaveType saveType;
+};
+
+constexpr KnownGame KNOWN_GAMES[] = {
+    {"SM", SaveType::EEPROM4K},  // Super Mario 64
+    {"KT", SaveType::EEPROM4K},  // Mario Kart 64
+    {"FX", SaveType::EEPROM4K},  // Star Fox 64
+    {"GE", SaveType::EEPROM4K},  // GoldenEye 007
+    {"BK", SaveType::EEPROM4K},  // Banjo-Kazooie
+    {"YS", SaveType::EEPROM16K}, // Yoshi's Story
+    {"ZL", SaveType::SRAM},      // The Legend of Zelda: Ocarina of Time
+    {"AL", SaveType::SRAM},      // Super Smash Bros.
+    {"ZS", SaveType::FlashRAM},  // The Legend of Zelda: Majora's Mask
+    {"MQ", SaveType::FlashRAM},  // Paper Mario
+};
+
+// ROM header fields
+namespace HeaderOffset {
+    enum : u64 {
+        GameID = 0x3C,
+        SaveType = 0x3F,
+    };
+}
+
+SaveType saveType = SaveType::Auto;
+
+sys::savefile::SaveFile *saveFile;
+u8 *saveData;
+
+FlashState flash;
+
+void setSaveType(const SaveType type) {
+    saveType = type;
+}
+
+struct SaveTypeName {
+    const char *name;
+    SaveType type;
+};
+
+// Save type names as used on the command line
+constexpr SaveTypeName SAVE_TYPE_NAMES[] = {
+    {"none", SaveType::None},
+    {"eeprom4k", SaveType::EEPROM4K},
+    {"eeprom16k", SaveType::EEPROM16K},
+    {"sram", SaveType::SRAM},
+    {"flash", SaveType::FlashRAM},
+};
+
+bool parseSaveType(const char *name, SaveType &type) {
+    for (const SaveTypeName &saveTypeName : SAVE_TYPE_NAMES) {
+        if (std::strcmp(name, saveTypeName.name) == 0) {
+            type = saveTypeName.type;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+SaveType detectSaveType() {
+    if (sys::memory::getROMSize() < 0x40) {
+        return SaveType::None;
+    }
+
+    const u8 *header = sys::memory::getPointer(sys::memory::MemoryBase::CART_DOM1_A2);
+
+    // Homebrew ROMs declare their save type in the header
+    if ((header[HeaderOffset::GameID + 0] == 'E') && (header[HeaderOffset::GameID + 1] == 'D')) {
+        switch (header[HeaderOffset::SaveType] >> 4) {
+            case 1:
+                return SaveType::EEPROM4K;
+            case 2:
+                return SaveType::EEPROM16K;
+            case 3:
+                return SaveType::SRAM;
+            case 5:
+                return SaveType::FlashRAM;
+            default:
+                return SaveType::None;
+        }
+    }
+
+    for (const KnownGame &game : KNOWN_GAMES) {
+        if ((header[HeaderOffset::GameID + 0] == game.id[0]) && (header[HeaderOffset::GameID + 1] == game.id[1])) {
+            return game.saveType;
+        }
+    }
+
+    return SaveType::None;
+}
+
+SaveType getSaveType() {
+    return saveType;
+}
+
+const char *getSaveTypeName(const SaveType type) {
+    for (const SaveTypeName &saveTypeName : SAVE_TYPE_NAMES) {
+        if (saveTypeName.type == type) {
+            return saveTypeName.name;
+        }
+    }
+
+    return "auto";
+}
+
+void init(const char *romPath) {
+    if (saveType == SaveType::Auto) {
+        saveType = detectSaveType();
+    }
+
+    std::string savePath = romPath;
+
+    u64 size;
+    u8 fill;
+
+    switch (saveType) {
+        case SaveType::EEPROM4K:
+        case SaveType::EEPROM16K:
+            savePath += ".eep";
+
+            size = (saveType == SaveType::EEPROM4K) ? SaveSize::EEPROM4K : SaveSize::EEPROM16K;
+            fill = 0xFF;
+            break;
+        case SaveType::SRAM:
+            savePath += ".sra";
+
+            size = SaveSize::SRAM;
+            fill = 0;
+            break;
+        case SaveType::FlashRAM:
+            savePath += ".fla";
+
+            size = SaveSize::FlashRAM;
+            fill = 0xFF;
+            break;
+        default:
+            PLOG_INFO << "No cartridge save memory";
+
+            saveFile = NULL;
+            saveData = NULL;
+            return;
+    }
+
+    saveFile = sys::savefile::open(savePath.c_str(), size, fill);
+    saveData = sys::savefile::getData(saveFile);
+}
+
+void deinit() {
+    if (saveFile != NULL) {
+        sys::savefile::close(saveFile);
+
+        saveFile = NULL;
+        saveData = NULL;
+    }
+}
+
+void reset() {
+    flash.mode = FlashMode::Read;
+    flash.status = 0;
+    flash.eraseOffset = 0;
+
+    std::memset(flash.pageBuffer, 0xFF, FLASH_PAGE_SIZE);
+}
+
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(flash);
+
+    sys::savefile::doSavestate(state, saveFile);
+}
+
+bool hasEEPROM() {
+    return (saveType == SaveType::EEPROM4K) || (saveType == SaveType::EEPROM16K);
+}
+
+u16 getEEPROMIdentifier() {
+    if (saveType == SaveType::EEPROM16K) {
+        return EEPROMIdentifier::EEPROM16K;
+    }
+
+    return EEPROMIdentifier::EEPROM4K;
+}
+
+u64 getEEPROMOffset(const u8 block) {
+    const u64 size = (saveType == SaveType::EEPROM16K) ? SaveSize::EEPROM16K : SaveSize::EEPROM4K;
+
+    return (EEPROM_BLOCK_SIZE * block) & (size - 1);
+}
+
+void readEEPROM(const u8 block, u8 *data) {
+    PLOG_VERBOSE << "EEPROM read (block = " << (u16)block << ")";
+
+    std::memcpy(data, &saveData[getEEPROMOffset(block)], EEPROM_BLOCK_SIZE);
+}
+
+void writeEEPROM(const u8 block, const u8 *data) {
+    PLOG_VERBOSE << "EEPROM write (block = " << (u16)block << ")";
+
+    const u64 offset = getEEPROMOffset(block);
+
+    std::memcpy(&saveData[offset], data, EEPROM_BLOCK_SIZE);
+
+    sys::savefile::markDirty(saveFile, offset, EEPROM_BLOCK_SIZE);
+}
+
+void doFlashCommand(const u32 command) {
+    PLOG_VERBOSE << "FlashRAM command " << std::hex << command;
+
+    switch (command >> 24) {
+        case FlashCommand::ChipEraseMode:
+            flash.mode = FlashMode::ChipErase;
+            break;
+        case FlashCommand::SectorEraseMode:
+            flash.mode = FlashMode::SectorErase;
+            flash.eraseOffset = ((command & 0xFFFF) * FLASH_PAGE_SIZE) & ~(FLASH_SECTOR_SIZE - 1);
+            break;
+        case FlashCommand::Erase:
+            if (flash.mode == FlashMode::ChipErase) {
+                std::memset(saveData, 0xFF, SaveSize::FlashRAM);
+
+                sys::savefile::markDirty(saveFile, 0, SaveSize::FlashRAM);
+            } else if ((flash.mode == FlashMode::SectorErase) && (flash.eraseOffset < SaveSize::FlashRAM)) {
+                std::memset(&saveData[flash.eraseOffset], 0xFF, FLASH_SECTOR_SIZE);
+
+                sys::savefile::markDirty(saveFile, flash.eraseOffset, FLASH_SECTOR_SIZE);
+            } else {
+                PLOG_WARNING << "FlashRAM erase without erase mode";
+            }
+
+            flash.status |= FlashStatus::EraseDone;
+            flash.mode = FlashMode::Status;
+            break;
+        case FlashCommand::WriteArray:
+            {
+                const u64 offset = (command & 0xFFFF) * FLASH_PAGE_SIZE;
+
+                if (offset < SaveSize::FlashRAM) {
+                    std::memcpy(&saveData[offset], flash.pageBuffer, FLASH_PAGE_SIZE);
+
+                    sys::savefile::markDirty(saveFile, offset, FLASH_PAGE_SIZE);
+                }
+
+                flash.status |= FlashStatus::WriteDone;
+                flash.mode = FlashMode::Status;
+            }
+            break;
+        case FlashCommand::WriteBufferMode:
+            flash.mode = FlashMode::WriteBuffer;
+            break;
+        case FlashCommand::StatusMode:
+            flash.mode = FlashMode::Status;
+            break;
+        case FlashCommand::IDMode:
+            flash.mode = FlashMode::ID;
+            break;
+        case FlashCommand::ReadMode:
+            flash.mode = FlashMode::Read;
+            break;
+        default:
+            PLOG_WARNING << "Unrecognized FlashRAM command " << std::hex << command;
+    }
+}
+
+bool mapDMA(const u64 cartaddr, const bool isWrite, sys::dma::Transfer &transfer) {
+    if ((cartaddr < Domain2Address::Base) || (cartaddr >= Domain2Address::End)) {
+        return false;
+    }
+
+    const u64 offset = cartaddr - Domain2Address::Base;
+
+    transfer.isLocalWrapping = false;
+
+    switch (saveType) {
+        case SaveType::SRAM:
+            transfer.local = saveData;
+            transfer.localAddr = offset;
+            transfer.localSize = SaveSize::SRAM;
+            return true;
+        case SaveType::FlashRAM:
+            if (isWrite) {
+                if (flash.mode != FlashMode::WriteBuffer) {
+                    PLOG_WARNING << "FlashRAM DMA write outside of write buffer mode";
+                }
+
+                transfer.local = flash.pageBuffer;
+                transfer.localAddr = 0;
+                transfer.localSize = FLASH_PAGE_SIZE;
+                return true;
+            }
+
+            switch (flash.mode) {
+                case FlashMode::Read:
+                    // Each PI address covers two bytes of FlashRAM
+                    transfer.local = saveData;
+                    transfer.localAddr = 2 * offset;
+                    transfer.localSize = SaveSize::FlashRAM;
+                    return true;
+                case FlashMode::ID:
+                    std::memcpy(flash.statusBuffer, FLASH_ID, sizeof(FLASH_ID));
+                    break;
+                default:
+                    std::memcpy(flash.statusBuffer, FLASH_ID, sizeof(FLASH_ID));
+
+                    flash.statusBuffer[3] = flash.status;
+                    break;
+            }
+
+            transfer.local = flash.statusBuffer;
+            transfer.localAddr = 0;
+            transfer.localSize = sizeof(flash.statusBuffer);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void finishDMAWrite(const u64 cartaddr, const u64 len) {
+    if (saveType == SaveType::SRAM) {
+        sys::savefile::markDirty(saveFile, cartaddr - Domain2Address::Base, len);
+    }
+}
+
+u32 read(const u64 paddr) {
+    const u64 offset = paddr - Domain2Address::Base;
+
+    switch (saveType) {
+        case SaveType::SRAM:
+            if ((offset + sizeof(u32)) <= SaveSize::SRAM) {
+                u32 data;
+                std::memcpy(&data, &saveData[offset], sizeof(u32));
+
+                return byteswap(data);
+            }
+            break;
+        case SaveType::FlashRAM:
+            // Status register
+            if ((flash.mode == FlashMode::Status) || (flash.mode == FlashMode::ID)) {
+                return ((u32)FLASH_ID[0] << 24) | ((u32)FLASH_ID[1] << 16) | ((u32)FLASH_ID[2] << 8) | flash.status;
+            }
+            break;
+        default:
+            break;
+    }
+
+    PLOG_WARNING << "Unmapped cartridge read (address = " << std::hex << paddr << ")";
+
+    return 0;
+}
+
+void write(const u64 paddr, const u32 data) {
+    const u64 offset = paddr - Domain2Address::Base;
+
+    switch (saveType) {
+        case SaveType::SRAM:
+            if ((offset + sizeof(u32)) <= SaveSize::SRAM) {
+                const u32 swappedData = byteswap(data);
+
+                std::memcpy(&saveData[offset], &swappedData, sizeof(u32));
+
+                sys::savefile::markDirty(saveFile, offset, sizeof(u32));
+
+                return;
+            }
+            break;
+        case SaveType::FlashRAM:
+            if (paddr == Domain2Address::FlashCommand) {
+                return doFlashCommand(data);
+            }
+
+            if (paddr == Domain2Address::FlashStatus) {
+                flash.status = data & 0xFF;
+
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    PLOG_WARNING << "Unmapped cartridge write (address = " << std::hex << paddr << ", data = " << data << ")";
+}
+
+}
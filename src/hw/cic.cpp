@@ -41,6 +41,12 @@ constexpr u64 SCRAMBLE(const u64 data, const int length) {
     return result;
 }
 
+// Taken from https://github.com/mupen64plus/mupen64plus-core/blob/master/src/device/cart/cic.c (n64_cic_nus_6105)
+constexpr u8 CHALLENGE_LUT[2][16] = {
+    {0x4, 0x7, 0xA, 0x7, 0xE, 0x5, 0xE, 0x1, 0xC, 0xF, 0x8, 0xF, 0x6, 0x3, 0x6, 0x9},
+    {0x4, 0x1, 0xA, 0x7, 0xE, 0x5, 0xE, 0x1, 0xC, 0x9, 0x8, 0x5, 0x6, 0x3, 0xC, 0x9},
+};
+
 constexpr u64 CIC_ID = 1;
 constexpr u64 CIC_SEEDS = 0xB53F3F;
 constexpr u64 CIC_CHECKSUM = 0xA536C0F1D859;
@@ -115,6 +121,43 @@ void reset() {
     setDataOut(CIC_ID, DataLength::ID);
 }
 
+void doSavestate(sys::savestate::State &savestate) {
+    savestate.doPOD(dataIn);
+    savestate.doPOD(dataOut);
+    savestate.doPOD(state);
+    savestate.doPOD(ram);
+}
+
+u64 getSeeds() {
+    return CIC_SEEDS;
+}
+
+void respondToChallenge(const u8 *challenge, u8 *response) {
+    u8 key = 0xB;
+    u64 lut = 0;
+
+    for (u64 i = 0; i < CHALLENGE_LENGTH; i++) {
+        response[i] = (key + 5 * challenge[i]) & 0xF;
+
+        key = CHALLENGE_LUT[lut][response[i]];
+
+        const int sign = (response[i] >> 3) & 1;
+        const int magnitude = ((sign == 1) ? ~response[i] : response[i]) & 7;
+
+        int mod = ((magnitude % 3) == 1) ? sign : (1 - sign);
+
+        if (lut == 1) {
+            if ((response[i] == 0x1) || (response[i] == 0x9)) {
+                mod = 1;
+            } else if ((response[i] == 0xB) || (response[i] == 0xE)) {
+                mod = 0;
+            }
+        }
+
+        lut = mod;
+    }
+}
+
 void setDataIn(const u64 length) {
     dataIn.data = 0;
     dataIn.length = length;
@@ -13,6 +13,7 @@
 #include <plog/Log.h>
 
 #include "hw/cpu/cpu.hpp"
+#include "hw/cpu/fpu.hpp"
 
 namespace hw::cpu::cop0 {
 
@@ -20,27 +21,6 @@ constexpr bool ENABLE_DISASSEMBLER = true;
 
 constexpr u32 CONFIG_DEFAULT = 0x6E460;
 
-// COP0 registers
-namespace Register {
-    enum : u32 {
-        Index = 0,
-        EntryLo0 = 2,
-        EntryLo1 = 3,
-        PageMask = 5,
-        Count = 9,
-        EntryHi = 10,
-        Compare = 11,
-        Status = 12,
-        Cause = 13,
-        EPC = 14,
-        Config = 16,
-        WatchLo = 18,
-        WatchHi = 19,
-        TagLo = 28,
-        TagHi = 29,
-    };
-};
-
 // Register write masks
 namespace WriteMask {
     enum : u32 {
@@ -147,6 +127,10 @@ void reset() {
     regs.config.raw = CONFIG_DEFAULT;
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+}
+
 bool isCoprocessorUsable(const u32 coprocessor) {
     // COP0 is always usable in Kernel mode
     if ((coprocessor == 0) && (regs.status.mode == CPUMode::Kernel)) {
@@ -257,6 +241,8 @@ void set(const u32 idx, const u32 data) {
         case Register::Status:
             regs.status.raw = data;
 
+            fpu::updateRegisterFile();
+
             checkInterruptPending();
             break;
         case Register::Cause:
@@ -420,4 +406,19 @@ void incrementCount() {
     regs.count &= 0x1FFFFFFFFULL;
 }
 
+void addCount(const u64 cycles) {
+    const u32 oldCount = regs.count >> 1;
+
+    regs.count = (regs.count + cycles) & 0x1FFFFFFFFULL;
+
+    const u32 newCount = regs.count >> 1;
+
+    // Raise the interrupt if Count passed Compare
+    if ((u32)(regs.compare - oldCount - 1) < (u32)(newCount - oldCount)) {
+        PLOG_VERBOSE << "Compare interrupt raised";
+
+        setInterruptPending(InterruptNumber::Compare);
+    }
+}
+
 }
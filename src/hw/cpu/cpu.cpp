@@ -6,6 +6,7 @@
 #include "hw/cpu/cpu.hpp"
 
 #include <array>
+#include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -15,9 +16,14 @@
 #include <plog/Log.h>
 
 #include "hw/cpu/cop0.hpp"
+#include "hw/cpu/disassembler.hpp"
 #include "hw/cpu/fpu.hpp"
+#include "hw/cpu/hle.hpp"
+#include "hw/cpu/lockstep.hpp"
 
 #include "sys/memory.hpp"
+#include "sys/stats.hpp"
+#include "sys/trace.hpp"
 
 namespace hw::cpu {
 
@@ -25,39 +31,6 @@ constexpr bool ENABLE_DISASSEMBLER = false;
 
 constexpr u32 ADDR_RESET_VECTOR = 0xBFC00000;
 
-// CPU virtual memory ranges
-namespace AddressRangeBase {
-    enum : u64 {
-        KUSEG = 0,
-        KSEG0 = 0x80000000,
-        KSEG1 = 0xA0000000,
-        KSSEG = 0xC0000000,
-        KSEG3 = 0xE0000000,
-    };
-}
-
-namespace AddressRangeSize {
-    enum : u64 {
-        KUSEG = 0x80000000,
-        KSEG0 = 0x20000000,
-        KSEG1 = 0x20000000,
-        KSSEG = 0x20000000,
-        KSEG3 = 0x20000000,
-    };
-}
-
-// CPU general-purpose registers
-namespace Register {
-    enum {
-        R0, AT, V0, V1, A0, A1, A2, A3,
-        T0, T1, T2, T3, T4, T5, T6, T7,
-        S0, S1, S2, S3, S4, S5, S6, S7,
-        T8, T9, K0, K1, GP, SP, S8, RA,
-        LO, HI,
-        NumberOfRegisters,
-    };
-}
-
 namespace Coprocessor {
     enum {
         SystemControl,
@@ -301,16 +274,27 @@ RegisterFile regFile;
 
 bool inDelaySlot[2];
 
+// Cycles charged by HLE routines past the end of the previous slice
+i64 overrunCycles;
+
 void init() {
     cop0::init();
+    fpu::init();
+    hle::init();
 }
 
 void deinit() {
     cop0::deinit();
+    fpu::deinit();
+    hle::deinit();
 }
 
 void reset() {
     cop0::reset();
+    fpu::reset();
+    hle::reset();
+
+    fpu::updateRegisterFile();
 
     // Clear register file
     std::memset(&regFile, 0, sizeof(RegisterFile));
@@ -319,6 +303,21 @@ void reset() {
     setPC(ADDR_RESET_VECTOR);
 
     inDelaySlot[0] = inDelaySlot[1] = false;
+
+    overrunCycles = 0;
+}
+
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regFile);
+    state.doPOD(inDelaySlot);
+    state.doPOD(overrunCycles);
+
+    cop0::doSavestate(state);
+    fpu::doSavestate(state);
+
+    if (state.isLoading()) {
+        fpu::updateRegisterFile();
+    }
 }
 
 void raiseException(const u32 exceptionCode) {
@@ -326,6 +325,8 @@ void raiseException(const u32 exceptionCode) {
 
     cop0::setExceptionCode(exceptionCode);
 
+    sys::stats::counters.exceptions[exceptionCode & (sys::stats::MAX_EXCEPTION_CODES - 1)]++;
+
     u64 vectorBase = 0xFFFFFFFF80000180;
     if (cop0::getBootExceptionVectors()) {
         PLOG_FATAL << "Unimplemented boot exception vectors";
@@ -455,105 +456,42 @@ void advancePC() {
     regFile.npc += sizeof(Instruction);
 }
 
-u64 translateAddress(const u64 vaddr) {
-    const u32 vaddrMasked = vaddr;
-    if ((vaddrMasked < AddressRangeBase::KSEG0) || (vaddrMasked >= AddressRangeBase::KSSEG)) {
-        PLOG_FATAL << "Unimplemented access to TLB mapped region (address = " << std::hex << vaddrMasked << ", PC = " << regFile.cpc << ")";
+void dumpState() {
+    std::printf("pc: %016" PRIX64 "\n", regFile.cpc);
 
-        for (u32 i = 0; i < Register::NumberOfRegisters; i++) {
-            std::printf("%s: %016llX\n", REG_NAMES[i], get(i));
-        }
-
-        exit(0);
+    for (u32 i = 0; i < Register::NumberOfRegisters; i++) {
+        std::printf("%s: %016" PRIX64 "\n", REG_NAMES[i], get(i));
     }
-
-    return vaddr & (AddressRangeSize::KSEG0 - 1);
-}
-
-template<>
-u8 read(const u64 vaddr) {
-    return sys::memory::read<u8>(translateAddress(vaddr));
 }
 
-template<>
-u16 read(const u64 vaddr) {
-    if (!isAlignedAddress<u16>(vaddr)) {
-        PLOG_FATAL << "Unaligned read16 address " << std::hex << vaddr;
+void unmappedAccess(const u64 vaddr) {
+    PLOG_FATAL << "Unimplemented access to TLB mapped region (address = " << std::hex << (u32)vaddr << ", PC = " << regFile.cpc << ")";
 
-        exit(0);
-    }
+    dumpState();
 
-    return sys::memory::read<u16>(translateAddress(vaddr));
+    exit(0);
 }
 
-template<>
-u32 read(const u64 vaddr) {
-    if (!isAlignedAddress<u32>(vaddr)) {
-        PLOG_FATAL << "Unaligned read32 address " << std::hex << vaddr;
-
-        exit(0);
-    }
+void unalignedAccess(const u64 vaddr, const u64 size, const bool isWrite) {
+    PLOG_FATAL << "Unaligned " << (isWrite ? "write" : "read") << std::dec << (8 * size) << " address " << std::hex << vaddr;
 
-    return sys::memory::read<u32>(translateAddress(vaddr));
+    exit(0);
 }
 
-template<>
-u64 read(const u64 vaddr) {
-    if (!isAlignedAddress<u64>(vaddr)) {
-        PLOG_FATAL << "Unaligned read64 address " << std::hex << vaddr;
+u32 fetch() {
+    const u64 pc = getCurrentPC();
 
-        exit(0);
+    if (!isAlignedAddress<u32>(pc)) [[unlikely]] {
+        unalignedAccess(pc, sizeof(u32), false);
     }
 
-    return sys::memory::read<u64>(translateAddress(vaddr));
-}
-
-u32 fetch() {
-    const u32 data = read<u32>(getCurrentPC());
+    const u32 data = sys::memory::fetch(translateAddress(pc));
 
     advancePC();
 
     return data;
 }
 
-template<>
-void write(const u64 vaddr, const u8 data) {
-    return sys::memory::write(translateAddress(vaddr), data);
-}
-
-template<>
-void write(const u64 vaddr, const u16 data) {
-    if (!isAlignedAddress<u16>(vaddr)) {
-        PLOG_FATAL << "Unaligned write16 address " << std::hex << vaddr;
-
-        exit(0);
-    }
-
-    return sys::memory::write(translateAddress(vaddr), data);
-}
-
-template<>
-void write(const u64 vaddr, const u32 data) {
-    if (!isAlignedAddress<u32>(vaddr)) {
-        PLOG_FATAL << "Unaligned write32 address " << std::hex << vaddr;
-
-        exit(0);
-    }
-
-    return sys::memory::write(translateAddress(vaddr), data);
-}
-
-template<>
-void write(const u64 vaddr, const u64 data) {
-    if (!isAlignedAddress<u64>(vaddr)) {
-        PLOG_FATAL << "Unaligned write64 address " << std::hex << vaddr;
-
-        exit(0);
-    }
-
-    return sys::memory::write(translateAddress(vaddr), data);
-}
-
 template<ALUOpImm op>
 void doALUImmediate(const Instruction instr) {
     const u32 rs = instr.iType.rs;
@@ -1518,10 +1456,7 @@ void doLoadStore(const Instruction instr) {
     }
 }
 
-void doInstruction() {
-    Instruction instr;
-    instr.raw = fetch();
-
+void execute(const Instruction instr) {
     const u32 op = instr.iType.op;
     switch (op) {
         case Opcode::SPECIAL: {
@@ -1794,16 +1729,91 @@ void doInstruction() {
     }
 }
 
+void doInstruction() {
+    Instruction instr;
+    instr.raw = fetch();
+
+    execute(instr);
+}
+
+// Runs one instruction and records it along with the GPR it wrote
+void doTracedInstruction() {
+    Instruction instr;
+    instr.raw = fetch();
+
+    execute(instr);
+
+    const int dest = disassembler::getDestinationRegister(instr.raw);
+
+    sys::trace::record(sys::trace::Core::CPU, regFile.cpc, instr.raw, (dest >= 0) ? get(dest) : 0);
+}
+
+void step() {
+    regFile.cpc = getPC();
+
+    advanceDelaySlot();
+
+    doInstruction();
+
+    cop0::incrementCount();
+}
+
 void run(const i64 cycles) {
-    for (i64 i = 0; i < cycles; i++) {
+    fpu::enterGuest();
+
+    const bool isHLEEnabled = hle::isEnabled();
+    const bool isLockstepEnabled = lockstep::isEnabled();
+    const bool isTracing = sys::trace::isActive(sys::trace::Core::CPU);
+
+    // High-level emulated routines don't count as instructions
+    u64 instructions = 0;
+
+    i64 i = overrunCycles;
+    while (i < cycles) {
         // Set current PC
         regFile.cpc = getPC();
 
         advanceDelaySlot();
-        doInstruction();
+
+        // Routines are always entered through a call, never from a delay slot
+        if (isHLEEnabled && !inDelaySlot[0]) {
+            // Lockstep runs the interpreter as well, which keeps COUNT up to date by itself
+            if (isLockstepEnabled) {
+                const i64 lockstepCycles = lockstep::tryCall(regFile.cpc);
+
+                if (lockstepCycles > 0) {
+                    i += lockstepCycles;
+                    continue;
+                }
+            }
+
+            const i64 hleCycles = hle::tryCall(regFile.cpc);
+
+            if (hleCycles > 0) {
+                cop0::addCount(hleCycles);
+
+                i += hleCycles;
+                continue;
+            }
+        }
+
+        if (isTracing) [[unlikely]] {
+            doTracedInstruction();
+        } else {
+            doInstruction();
+        }
 
         cop0::incrementCount();
+
+        instructions++;
+        i++;
     }
+
+    sys::stats::counters.cpuInstructions += instructions;
+
+    overrunCycles = i - cycles;
+
+    fpu::leaveGuest();
 }
 
 }
@@ -0,0 +1,372 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/cpu/disassembler.hpp"
+
+#include <cstdio>
+
+#include "hw/cpu/cpu.hpp"
+
+namespace hw::cpu::disassembler {
+
+// Operand layouts
+enum class Format {
+    Invalid,
+    None,
+    RdRsRt,
+    RdRtSa,
+    RdRtRs,
+    Rs,
+    Rd,
+    RdRs,
+    RsRt,
+    RtRsImm,
+    RtRsImmU,
+    RtImm,
+    RsRtBranch,
+    RsBranch,
+    Jump,
+    RtOffBase,
+    FtOffBase,
+    CacheOffBase,
+};
+
+struct Entry {
+    const char *name;
+    Format format;
+};
+
+constexpr const char *REG_NAMES[32] = {
+    "r0", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+    "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+    "t8", "t9", "k0", "k1", "gp", "sp", "s8", "ra",
+};
+
+constexpr Entry INVALID = {NULL, Format::Invalid};
+
+constexpr Entry OPCODES[64] = {
+    // 0x00
+    INVALID, INVALID, {"j", Format::Jump}, {"jal", Format::Jump},
+    {"beq", Format::RsRtBranch}, {"bne", Format::RsRtBranch}, {"blez", Format::RsBranch}, {"bgtz", Format::RsBranch},
+    {"addi", Format::RtRsImm}, {"addiu", Format::RtRsImm}, {"slti", Format::RtRsImm}, {"sltiu", Format::RtRsImm},
+    {"andi", Format::RtRsImmU}, {"ori", Format::RtRsImmU}, {"xori", Format::RtRsImmU}, {"lui", Format::RtImm},
+    // 0x10
+    INVALID, INVALID, INVALID, INVALID,
+    {"beql", Format::RsRtBranch}, {"bnel", Format::RsRtBranch}, {"blezl", Format::RsBranch}, {"bgtzl", Format::RsBranch},
+    {"daddi", Format::RtRsImm}, {"daddiu", Format::RtRsImm}, {"ldl", Format::RtOffBase}, {"ldr", Format::RtOffBase},
+    INVALID, INVALID, INVALID, INVALID,
+    // 0x20
+    {"lb", Format::RtOffBase}, {"lh", Format::RtOffBase}, {"lwl", Format::RtOffBase}, {"lw", Format::RtOffBase},
+    {"lbu", Format::RtOffBase}, {"lhu", Format::RtOffBase}, {"lwr", Format::RtOffBase}, {"lwu", Format::RtOffBase},
+    {"sb", Format::RtOffBase}, {"sh", Format::RtOffBase}, {"swl", Format::RtOffBase}, {"sw", Format::RtOffBase},
+    {"sdl", Format::RtOffBase}, {"sdr", Format::RtOffBase}, {"swr", Format::RtOffBase}, {"cache", Format::CacheOffBase},
+    // 0x30
+    {"ll", Format::RtOffBase}, {"lwc1", Format::FtOffBase}, INVALID, INVALID,
+    {"lld", Format::RtOffBase}, {"ldc1", Format::FtOffBase}, INVALID, {"ld", Format::RtOffBase},
+    {"sc", Format::RtOffBase}, {"swc1", Format::FtOffBase}, INVALID, INVALID,
+    {"scd", Format::RtOffBase}, {"sdc1", Format::FtOffBase}, INVALID, {"sd", Format::RtOffBase},
+};
+
+constexpr Entry SPECIAL_OPCODES[64] = {
+    // 0x00
+    {"sll", Format::RdRtSa}, INVALID, {"srl", Format::RdRtSa}, {"sra", Format::RdRtSa},
+    {"sllv", Format::RdRtRs}, INVALID, {"srlv", Format::RdRtRs}, {"srav", Format::RdRtRs},
+    {"jr", Format::Rs}, {"jalr", Format::RdRs}, INVALID, INVALID,
+    {"syscall", Format::None}, {"break", Format::None}, INVALID, {"sync", Format::None},
+    // 0x10
+    {"mfhi", Format::Rd}, {"mthi", Format::Rs}, {"mflo", Format::Rd}, {"mtlo", Format::Rs},
+    {"dsllv", Format::RdRtRs}, INVALID, {"dsrlv", Format::RdRtRs}, {"dsrav", Format::RdRtRs},
+    {"mult", Format::RsRt}, {"multu", Format::RsRt}, {"div", Format::RsRt}, {"divu", Format::RsRt},
+    {"dmult", Format::RsRt}, {"dmultu", Format::RsRt}, {"ddiv", Format::RsRt}, {"ddivu", Format::RsRt},
+    // 0x20
+    {"add", Format::RdRsRt}, {"addu", Format::RdRsRt}, {"sub", Format::RdRsRt}, {"subu", Format::RdRsRt},
+    {"and", Format::RdRsRt}, {"or", Format::RdRsRt}, {"xor", Format::RdRsRt}, {"nor", Format::RdRsRt},
+    INVALID, INVALID, {"slt", Format::RdRsRt}, {"sltu", Format::RdRsRt},
+    {"dadd", Format::RdRsRt}, {"daddu", Format::RdRsRt}, {"dsub", Format::RdRsRt}, {"dsubu", Format::RdRsRt},
+    // 0x30
+    {"tge", Format::RsRt}, {"tgeu", Format::RsRt}, {"tlt", Format::RsRt}, {"tltu", Format::RsRt},
+    {"teq", Format::RsRt}, INVALID, {"tne", Format::RsRt}, INVALID,
+    {"dsll", Format::RdRtSa}, INVALID, {"dsrl", Format::RdRtSa}, {"dsra", Format::RdRtSa},
+    {"dsll32", Format::RdRtSa}, INVALID, {"dsrl32", Format::RdRtSa}, {"dsra32", Format::RdRtSa},
+};
+
+constexpr const char *REGIMM_NAMES[32] = {
+    "bltz", "bgez", "bltzl", "bgezl", NULL, NULL, NULL, NULL,
+    "tgei", "tgeiu", "tlti", "tltiu", "teqi", NULL, "tnei", NULL,
+    "bltzal", "bgezal", "bltzall", "bgezall", NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+};
+
+constexpr const char *FPU_NAMES[64] = {
+    "add", "sub", "mul", "div", "sqrt", "abs", "mov", "neg",
+    "round.l", "trunc.l", "ceil.l", "floor.l", "round.w", "trunc.w", "ceil.w", "floor.w",
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    "cvt.s", "cvt.d", NULL, NULL, "cvt.w", "cvt.l", NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    "c.f", "c.un", "c.eq", "c.ueq", "c.olt", "c.ult", "c.ole", "c.ule",
+    "c.sf", "c.ngle", "c.seq", "c.ngl", "c.lt", "c.nge", "c.le", "c.ngt",
+};
+
+// Only the instructions that take two source operands
+constexpr bool isTwoOperandFPU(const u32 funct) {
+    return (funct < 4) || (funct >= 0x30);
+}
+
+const char *getRegisterName(const u32 idx) {
+    return REG_NAMES[idx & 31];
+}
+
+std::string format(const char *fmt, auto... args) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), fmt, args...);
+
+    return buffer;
+}
+
+std::string invalid(const u32 instr) {
+    return format(".word 0x%08X", instr);
+}
+
+std::string disassembleFormat(const char *name, const Format fmt, const u64 pc, const u32 instr) {
+    const u32 rs = (instr >> 21) & 31;
+    const u32 rt = (instr >> 16) & 31;
+    const u32 rd = (instr >> 11) & 31;
+    const u32 sa = (instr >> 6) & 31;
+
+    const i16 imm = (i16)instr;
+
+    const u32 branchTarget = (u32)pc + 4 + ((i32)imm << 2);
+
+    switch (fmt) {
+        case Format::None:
+            return name;
+        case Format::RdRsRt:
+            return format("%s %s, %s, %s", name, REG_NAMES[rd], REG_NAMES[rs], REG_NAMES[rt]);
+        case Format::RdRtSa:
+            return format("%s %s, %s, %u", name, REG_NAMES[rd], REG_NAMES[rt], sa);
+        case Format::RdRtRs:
+            return format("%s %s, %s, %s", name, REG_NAMES[rd], REG_NAMES[rt], REG_NAMES[rs]);
+        case Format::Rs:
+            return format("%s %s", name, REG_NAMES[rs]);
+        case Format::Rd:
+            return format("%s %s", name, REG_NAMES[rd]);
+        case Format::RdRs:
+            return format("%s %s, %s", name, REG_NAMES[rd], REG_NAMES[rs]);
+        case Format::RsRt:
+            return format("%s %s, %s", name, REG_NAMES[rs], REG_NAMES[rt]);
+        case Format::RtRsImm:
+            return format("%s %s, %s, %d", name, REG_NAMES[rt], REG_NAMES[rs], imm);
+        case Format::RtRsImmU:
+            return format("%s %s, %s, 0x%04X", name, REG_NAMES[rt], REG_NAMES[rs], (u16)imm);
+        case Format::RtImm:
+            return format("%s %s, 0x%04X", name, REG_NAMES[rt], (u16)imm);
+        case Format::RsRtBranch:
+            return format("%s %s, %s, 0x%08X", name, REG_NAMES[rs], REG_NAMES[rt], branchTarget);
+        case Format::RsBranch:
+            return format("%s %s, 0x%08X", name, REG_NAMES[rs], branchTarget);
+        case Format::Jump:
+            return format("%s 0x%08X", name, (u32)((pc + 4) & 0xF0000000) | ((instr & 0x3FFFFFF) << 2));
+        case Format::RtOffBase:
+            return format("%s %s, %d(%s)", name, REG_NAMES[rt], imm, REG_NAMES[rs]);
+        case Format::FtOffBase:
+            return format("%s f%u, %d(%s)", name, rt, imm, REG_NAMES[rs]);
+        case Format::CacheOffBase:
+            return format("%s 0x%02X, %d(%s)", name, rt, imm, REG_NAMES[rs]);
+        default:
+            return invalid(instr);
+    }
+}
+
+std::string disassembleCoprocessor(const u32 coprocessor, const u64 pc, const u32 instr) {
+    const u32 rs = (instr >> 21) & 31;
+    const u32 rt = (instr >> 16) & 31;
+    const u32 rd = (instr >> 11) & 31;
+    const u32 funct = instr & 63;
+
+    const char *prefix = (coprocessor == 0) ? "" : "f";
+
+    switch (rs) {
+        case 0x00:
+            return format("mfc%u %s, %s%u", coprocessor, REG_NAMES[rt], prefix, rd);
+        case 0x01:
+            return format("dmfc%u %s, %s%u", coprocessor, REG_NAMES[rt], prefix, rd);
+        case 0x02:
+            return format("cfc%u %s, %u", coprocessor, REG_NAMES[rt], rd);
+        case 0x04:
+            return format("mtc%u %s, %s%u", coprocessor, REG_NAMES[rt], prefix, rd);
+        case 0x05:
+            return format("dmtc%u %s, %s%u", coprocessor, REG_NAMES[rt], prefix, rd);
+        case 0x06:
+            return format("ctc%u %s, %u", coprocessor, REG_NAMES[rt], rd);
+        case 0x08:
+            {
+                constexpr const char *CONDITIONS[4] = {"f", "t", "fl", "tl"};
+
+                if (rt >= 4) {
+                    return invalid(instr);
+                }
+
+                return format("bc%u%s 0x%08X", coprocessor, CONDITIONS[rt], (u32)pc + 4 + ((i32)(i16)instr << 2));
+            }
+        default:
+            break;
+    }
+
+    if (rs < 0x10) {
+        return invalid(instr);
+    }
+
+    if (coprocessor == 0) {
+        switch (funct) {
+            case 0x01:
+                return "tlbr";
+            case 0x02:
+                return "tlbwi";
+            case 0x06:
+                return "tlbwr";
+            case 0x08:
+                return "tlbp";
+            case 0x18:
+                return "eret";
+            default:
+                return invalid(instr);
+        }
+    }
+
+    // FPU compute, rs is the format
+    const char *fmt;
+    switch (rs) {
+        case 0x10:
+            fmt = "s";
+            break;
+        case 0x11:
+            fmt = "d";
+            break;
+        case 0x14:
+            fmt = "w";
+            break;
+        case 0x15:
+            fmt = "l";
+            break;
+        default:
+            return invalid(instr);
+    }
+
+    if (FPU_NAMES[funct] == NULL) {
+        return invalid(instr);
+    }
+
+    const u32 ft = rt;
+    const u32 fs = rd;
+    const u32 fd = (instr >> 6) & 31;
+
+    if (funct >= 0x30) {
+        return format("%s.%s f%u, f%u", FPU_NAMES[funct], fmt, fs, ft);
+    } else if (isTwoOperandFPU(funct)) {
+        return format("%s.%s f%u, f%u, f%u", FPU_NAMES[funct], fmt, fd, fs, ft);
+    }
+
+    return format("%s.%s f%u, f%u", FPU_NAMES[funct], fmt, fd, fs);
+}
+
+int getDestinationRegister(const u32 instr) {
+    const u32 op = instr >> 26;
+
+    const int rt = (instr >> 16) & 31;
+    const int rd = (instr >> 11) & 31;
+
+    int dest = -1;
+    switch (op) {
+        case 0x00:
+            {
+                const u32 funct = instr & 63;
+
+                // Everything but jumps, system instructions, HI/LO writes and traps writes rd
+                if ((funct == 0x08) || ((funct >= 0x0C) && (funct <= 0x0F)) || (funct == 0x11) || (funct == 0x13)
+                    || ((funct >= 0x18) && (funct <= 0x1F)) || ((funct >= 0x30) && (funct <= 0x37))) {
+                    break;
+                }
+
+                dest = rd;
+            }
+            break;
+        case 0x01:
+            // Linking branches
+            if ((rt & 0x10) != 0) {
+                dest = Register::RA;
+            }
+            break;
+        case 0x03:
+            dest = Register::RA;
+            break;
+        case 0x10:
+        case 0x11:
+            {
+                // MFC/DMFC/CFC
+                const u32 rs = (instr >> 21) & 31;
+
+                if (rs <= 0x02) {
+                    dest = rt;
+                }
+            }
+            break;
+        default:
+            // Immediate ALU, loads and conditional stores
+            if (((op >= 0x08) && (op <= 0x0F)) || (op == 0x18) || (op == 0x19) || ((op >= 0x1A) && (op <= 0x1B))
+                || ((op >= 0x20) && (op <= 0x27)) || (op == 0x30) || (op == 0x34) || (op == 0x37) || (op == 0x38) || (op == 0x3C)) {
+                dest = rt;
+            }
+            break;
+    }
+
+    // Writes to r0 are discarded
+    return (dest == 0) ? -1 : dest;
+}
+
+std::string disassemble(const u64 pc, const u32 instr) {
+    const u32 op = instr >> 26;
+
+    switch (op) {
+        case 0x00:
+            {
+                if (instr == 0) {
+                    return "nop";
+                }
+
+                const Entry &entry = SPECIAL_OPCODES[instr & 63];
+
+                return disassembleFormat(entry.name, entry.format, pc, instr);
+            }
+        case 0x01:
+            {
+                const u32 rt = (instr >> 16) & 31;
+
+                if (REGIMM_NAMES[rt] == NULL) {
+                    return invalid(instr);
+                }
+
+                // Trap immediates compare against a signed immediate, branches jump
+                if ((rt >= 0x08) && (rt < 0x10)) {
+                    return format("%s %s, %d", REGIMM_NAMES[rt], REG_NAMES[(instr >> 21) & 31], (i16)instr);
+                }
+
+                return disassembleFormat(REGIMM_NAMES[rt], Format::RsBranch, pc, instr);
+            }
+        case 0x10:
+            return disassembleCoprocessor(0, pc, instr);
+        case 0x11:
+            return disassembleCoprocessor(1, pc, instr);
+        default:
+            {
+                const Entry &entry = OPCODES[op];
+
+                return disassembleFormat(entry.name, entry.format, pc, instr);
+            }
+    }
+}
+
+}
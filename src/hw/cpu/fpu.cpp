@@ -5,11 +5,19 @@
 
 #include "hw/cpu/fpu.hpp"
 
+#include <bit>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ios>
+#include <tuple>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#else
+#include <cfenv>
+#endif
 
 #include <plog/Log.h>
 
@@ -18,7 +26,7 @@
 
 namespace hw::cpu::fpu {
 
-constexpr bool ENABLE_DISASSEMBLER = true;
+constexpr bool ENABLE_DISASSEMBLER = false;
 
 constexpr u64 FPR_NUM = 32;
 constexpr u64 FPR_MASK = FPR_NUM - 2;
@@ -33,9 +41,12 @@ namespace Format {
     };
 }
 
-constexpr const char *FORMAT_NAMES[Format::NumberOfFormats] = {
-    "Single", "Double", "Word", "Long",
-};
+// Host type of each format
+template<int format>
+using FormatType = std::tuple_element_t<format, std::tuple<f32, f64, i32, i64>>;
+
+template<int format>
+constexpr bool isFloatFormat = (format == Format::Single) || (format == Format::Double);
 
 constexpr char FORMAT_CHARS[Format::NumberOfFormats] = {
     's', 'd', 'w', 'l',
@@ -93,6 +104,42 @@ constexpr const char *MODE_NAMES[RoundingMode::NumberOfRoundingModes] = {
     "Toward -Inf",
 };
 
+// Bits of the FCR31 flag field
+namespace ExceptionFlag {
+    enum : u32 {
+        Inexact = 1 << 0,
+        Underflow = 1 << 1,
+        Overflow = 1 << 2,
+        DivideByZero = 1 << 3,
+        Invalid = 1 << 4,
+    };
+}
+
+#if defined(__SSE2__)
+namespace MXCSR {
+    enum : u32 {
+        InvalidFlag = 1 << 0,
+        DivideByZeroFlag = 1 << 2,
+        OverflowFlag = 1 << 3,
+        UnderflowFlag = 1 << 4,
+        InexactFlag = 1 << 5,
+        FlagMask = 0x3F,
+        ExceptionMask = 0x3F << 7,
+        RoundingShift = 13,
+        FlushToZero = 1 << 15,
+    };
+}
+
+// MXCSR rounding control for each FCR31 rounding mode
+constexpr u32 HOST_ROUNDING_MODES[RoundingMode::NumberOfRoundingModes] = {
+    0, 3, 2, 1,
+};
+#else
+constexpr int HOST_ROUNDING_MODES[RoundingMode::NumberOfRoundingModes] = {
+    FE_TONEAREST, FE_TOWARDZERO, FE_UPWARD, FE_DOWNWARD,
+};
+#endif
+
 namespace Opcode {
     enum : u32 {
         ADD = 0x00,
@@ -136,44 +183,184 @@ struct Registers {
 
 Registers regs;
 
+// FPR index and bit offset of every 32-bit register, depends on Status.FR
+u8 longIndex[FPR_NUM];
+u8 wordShift[FPR_NUM];
+
+// Host FPU state while the CPU runs, derived from FCR31
+#if defined(__SSE2__)
+u32 guestMXCSR, hostMXCSR;
+#else
+std::fenv_t hostEnvironment;
+#endif
+
+bool isGuestActive = false;
+
+void updateHostControl();
+
 void init() {}
 
 void deinit() {}
 
 void reset() {
     std::memset(&regs, 0, sizeof(Registers));
+
+    updateHostControl();
 }
 
-bool getCondition() {
-    return regs.control.condition != 0;
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+
+    if (state.isLoading()) {
+        updateHostControl();
+    }
+}
+
+void updateRegisterFile() {
+    const bool isLarge = cop0::isLargeFPURegisterFile();
+
+    for (u32 idx = 0; idx < FPR_NUM; idx++) {
+        if (isLarge) {
+            longIndex[idx] = idx;
+            wordShift[idx] = 0;
+        } else {
+            // Odd registers are the upper halves of even ones
+            longIndex[idx] = idx & FPR_MASK;
+            wordShift[idx] = 32 * (idx & 1);
+        }
+    }
+}
+
+// Recomputes the host rounding/flush modes, takes effect immediately if the CPU is running
+void updateHostControl() {
+#if defined(__SSE2__)
+    guestMXCSR = MXCSR::ExceptionMask | (HOST_ROUNDING_MODES[regs.control.roundingMode] << MXCSR::RoundingShift);
+
+    if (regs.control.flushEnable != 0) {
+        guestMXCSR |= MXCSR::FlushToZero;
+    }
+
+    if (isGuestActive) {
+        _mm_setcsr(guestMXCSR);
+    }
+#else
+    if (isGuestActive) {
+        std::feclearexcept(FE_ALL_EXCEPT);
+        std::fesetround(HOST_ROUNDING_MODES[regs.control.roundingMode]);
+    }
+#endif
+}
+
+// Moves exceptions raised by host operations into the FCR31 flags
+void collectFlags() {
+    if (!isGuestActive) {
+        return;
+    }
+
+    u32 flags = 0;
+
+#if defined(__SSE2__)
+    const u32 mxcsr = _mm_getcsr();
+
+    if ((mxcsr & MXCSR::InexactFlag) != 0) {
+        flags |= ExceptionFlag::Inexact;
+    }
+
+    if ((mxcsr & MXCSR::UnderflowFlag) != 0) {
+        flags |= ExceptionFlag::Underflow;
+    }
+
+    if ((mxcsr & MXCSR::OverflowFlag) != 0) {
+        flags |= ExceptionFlag::Overflow;
+    }
+
+    if ((mxcsr & MXCSR::DivideByZeroFlag) != 0) {
+        flags |= ExceptionFlag::DivideByZero;
+    }
+
+    if ((mxcsr & MXCSR::InvalidFlag) != 0) {
+        flags |= ExceptionFlag::Invalid;
+    }
+
+    _mm_setcsr(mxcsr & ~MXCSR::FlagMask);
+#else
+    if (std::fetestexcept(FE_INEXACT) != 0) {
+        flags |= ExceptionFlag::Inexact;
+    }
+
+    if (std::fetestexcept(FE_UNDERFLOW) != 0) {
+        flags |= ExceptionFlag::Underflow;
+    }
+
+    if (std::fetestexcept(FE_OVERFLOW) != 0) {
+        flags |= ExceptionFlag::Overflow;
+    }
+
+    if (std::fetestexcept(FE_DIVBYZERO) != 0) {
+        flags |= ExceptionFlag::DivideByZero;
+    }
+
+    if (std::fetestexcept(FE_INVALID) != 0) {
+        flags |= ExceptionFlag::Invalid;
+    }
+
+    std::feclearexcept(FE_ALL_EXCEPT);
+#endif
+
+    regs.control.flag |= flags;
 }
 
-f32 makeSingle(const u32 data) {
-    f32 single;
-    std::memcpy(&single, &data, sizeof(f32));
+void enterGuest() {
+#if defined(__SSE2__)
+    hostMXCSR = _mm_getcsr();
+#else
+    std::fegetenv(&hostEnvironment);
+#endif
+
+    isGuestActive = true;
 
-    return single;
+    updateHostControl();
 }
 
-f64 makeDouble(const u64 data) {
-    f64 double_;
-    std::memcpy(&double_, &data, sizeof(f64));
+void leaveGuest() {
+    collectFlags();
+
+#if defined(__SSE2__)
+    _mm_setcsr(hostMXCSR);
+#else
+    std::fesetenv(&hostEnvironment);
+#endif
 
-    return double_;
+    isGuestActive = false;
 }
 
-u32 makeWord(const f32 data) {
-    u32 word;
-    std::memcpy(&word, &data, sizeof(u32));
+bool getCondition() {
+    return regs.control.condition != 0;
+}
 
-    return word;
+// Register file accessors without bounds checks, indices come from 5-bit instruction fields
+template<typename T>
+T getFPR(const u32 idx) {
+    const u64 data = regs.fprs[longIndex[idx]];
+
+    if constexpr (sizeof(T) == sizeof(u32)) {
+        return std::bit_cast<T>((u32)(data >> wordShift[idx]));
+    } else {
+        return std::bit_cast<T>(data);
+    }
 }
 
-u64 makeLong(const f64 data) {
-    u64 long_;
-    std::memcpy(&long_, &data, sizeof(u64));
+template<typename T>
+void setFPR(const u32 idx, const T data) {
+    u64 &fpr = regs.fprs[longIndex[idx]];
 
-    return long_;
+    if constexpr (sizeof(T) == sizeof(u32)) {
+        const u32 shift = wordShift[idx];
+
+        fpr = (fpr & ~(0xFFFFFFFFULL << shift)) | ((u64)std::bit_cast<u32>(data) << shift);
+    } else {
+        fpr = std::bit_cast<u64>(data);
+    }
 }
 
 template<>
@@ -184,15 +371,7 @@ u32 get(const u32 idx) {
         exit(0);
     }
 
-    if (cop0::isLargeFPURegisterFile()) {
-        return (u32)regs.fprs[idx];
-    } else {
-        if ((idx & 1) != 0) {
-            return (u32)(regs.fprs[idx & FPR_MASK] >> 32);
-        } else {
-            return (u32)regs.fprs[idx];
-        }
-    }
+    return getFPR<u32>(idx);
 }
 
 template<>
@@ -202,12 +381,8 @@ u64 get(const u32 idx) {
 
         exit(0);
     }
-    
-    if (cop0::isLargeFPURegisterFile()) {
-        return regs.fprs[idx];
-    }
 
-    return regs.fprs[idx & FPR_MASK];
+    return getFPR<u64>(idx);
 }
 
 u32 getControl(const u32 idx) {
@@ -219,6 +394,8 @@ u32 getControl(const u32 idx) {
 
     switch (idx) {
         case ControlRegister::Control:
+            collectFlags();
+
             return regs.control.raw;
         default:
             PLOG_FATAL << "Unrecognized Control register " << idx;
@@ -235,18 +412,7 @@ void set(const u32 idx, const u32 data) {
         exit(0);
     }
 
-    if (cop0::isLargeFPURegisterFile()) {
-        regs.fprs[idx] &= 0xFFFFFFFF00000000ULL;
-        regs.fprs[idx] |= (u64)data;
-    } else {
-        if ((idx & 1) != 0) {
-            regs.fprs[idx & FPR_MASK] &= 0xFFFFFFFFULL;
-            regs.fprs[idx & FPR_MASK] |= (u64)data << 32;
-        } else {
-            regs.fprs[idx] &= 0xFFFFFFFF00000000ULL;
-            regs.fprs[idx] |= (u64)data;
-        }
-    }
+    setFPR(idx, data);
 }
 
 template<>
@@ -257,11 +423,7 @@ void set(const u32 idx, const u64 data) {
         exit(0);
     }
 
-    if (cop0::isLargeFPURegisterFile()) {
-        regs.fprs[idx] = data;
-    } else {
-        regs.fprs[idx & FPR_MASK] = data;
-    }
+    setFPR(idx, data);
 }
 
 void setControl(const u32 idx, const u32 data) {
@@ -275,6 +437,9 @@ void setControl(const u32 idx, const u32 data) {
         case ControlRegister::Control:
             regs.control.raw = data;
 
+            // Rounding/flush modes only change here, so the host FPU is only reprogrammed here
+            updateHostControl();
+
             PLOG_VERBOSE << "FPU rounding mode = " << MODE_NAMES[regs.control.roundingMode];
             break;
         default:
@@ -286,63 +451,34 @@ void setControl(const u32 idx, const u32 data) {
 
 template<int format>
 void ADD(const Instruction instr) {
-    if ((format != Format::Single) && (format != Format::Double)) {
-        PLOG_FATAL << "Invalid format for ADD";
+    static_assert(isFloatFormat<format>, "Invalid format for ADD");
 
-        exit(0);
-    }
+    using T = FormatType<format>;
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
     const u32 ft = instr.fType.ft;
 
-    switch (format) {
-        case Format::Single:
-            set(fd, makeWord(makeSingle(get<u32>(fs)) + makeSingle(get<u32>(ft))));
-            break;
-        case Format::Double:
-            set(fd, makeLong(makeDouble(get<u64>(fs)) + makeDouble(get<u64>(ft))));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
-
-            exit(0);
-    }
+    setFPR<T>(fd, getFPR<T>(fs) + getFPR<T>(ft));
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        f64 data = makeDouble(get<u64>(fd));
-        if (format == Format::Single) {
-            data = (f64)makeSingle(get<u32>(fd));
-        }
-
-        std::printf("[%08X:%08X] add.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, data);
+        std::printf("[%08X:%08X] add.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, (f64)getFPR<T>(fd));
     }
 }
 
 template<int format>
 void CCOND(const Instruction instr) {
-    if ((format != Format::Single) && (format != Format::Double)) {
-        PLOG_FATAL << "Invalid format for C.COND";
+    static_assert(isFloatFormat<format>, "Invalid format for C.COND");
 
-        exit(0);
-    }
+    using T = FormatType<format>;
 
     const u32 fs = instr.fType.fs;
     const u32 ft = instr.fType.ft;
 
-    f64 fsData, ftData;
-    switch (format) {
-        case Format::Single:
-            fsData = (f64)makeSingle(get<u32>(fs));
-            ftData = (f64)makeSingle(get<u32>(ft));
-            break;
-        case Format::Double:
-            fsData = makeDouble(get<u64>(fs));
-            ftData = makeDouble(get<u64>(ft));
-            break;
-    }
+    const T fsData = getFPR<T>(fs);
+    const T ftData = getFPR<T>(ft);
 
     const u32 condition = instr.fType.funct & 0xF;
     u32 flags = 0;
@@ -368,296 +504,157 @@ void CCOND(const Instruction instr) {
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        std::printf("[%08X:%08X] c.%s.%c %u, %u; %u = %lf, %u = %lf, COND = %u\n", pc, instr.raw, CONDITION_NAMES[condition], FORMAT_CHARS[format], fs, ft, fs, fsData, ft, ftData, regs.control.condition);
+        std::printf("[%08X:%08X] c.%s.%c %u, %u; %u = %lf, %u = %lf, COND = %u\n", pc, instr.raw, CONDITION_NAMES[condition], FORMAT_CHARS[format], fs, ft, fs, (f64)fsData, ft, (f64)ftData, regs.control.condition);
     }
 }
 
 template<int format>
 void CVTD(const Instruction instr) {
-    if (format == Format::Double) {
-        PLOG_FATAL << "Invalid format for CVT.D";
-
-        exit(0);
-    }
+    static_assert(format != Format::Double, "Invalid format for CVT.D");
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
 
-    u64 data;
-    switch (format) {
-        case Format::Single:
-            data = makeLong((f64)makeSingle(get<u32>(fs)));
-            break;
-        case Format::Word:
-            data = makeLong((f64)get<u32>(fs));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
-
-            exit(0);
-    }
+    const f64 data = (f64)getFPR<FormatType<format>>(fs);
 
-    set<u64>(fd, data);
+    setFPR<f64>(fd, data);
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        const f64 double_ = makeDouble(data);
-
-        std::printf("[%08X:%08X] cvt.d.%c %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, double_);
+        std::printf("[%08X:%08X] cvt.d.%c %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, data);
     }
 }
 
 template<int format>
 void CVTS(const Instruction instr) {
-    if (format == Format::Single) {
-        PLOG_FATAL << "Invalid format for CVT.S";
-
-        exit(0);
-    }
+    static_assert(format != Format::Single, "Invalid format for CVT.S");
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
 
-    u32 data;
-    switch (format) {
-        case Format::Double:
-            data = makeWord((f32)makeDouble(get<u64>(fs)));
-            break;
-        case Format::Word:
-            data = makeWord((f32)get<u32>(fs));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
-
-            exit(0);
-    }
+    // Rounds according to FCR31
+    const f32 data = (f32)getFPR<FormatType<format>>(fs);
 
-    set<u32>(fd, data);
+    setFPR<f32>(fd, data);
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        const f32 single = makeSingle(data);
-
-        std::printf("[%08X:%08X] cvt.s.%c %u, %u; %u = %f\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, single);
+        std::printf("[%08X:%08X] cvt.s.%c %u, %u; %u = %f\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, data);
     }
 }
 
-
-
 template<int format>
 void CVTW(const Instruction instr) {
-    if (format == Format::Word) {
-        PLOG_FATAL << "Invalid format for CVT.W";
-
-        exit(0);
-    }
+    static_assert(isFloatFormat<format>, "Invalid format for CVT.W");
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
 
-    u32 data;
-    switch (format) {
-        case Format::Single:
-            data = (u32)makeSingle(get<u32>(fs));
-            break;
-        case Format::Double:
-            data = (u32)makeDouble(get<u64>(fs));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
+    // Rounds according to FCR31
+    const i32 data = (i32)std::lrint(getFPR<FormatType<format>>(fs));
 
-            exit(0);
-    }
-
-    set<u32>(fd, data);
+    setFPR<i32>(fd, data);
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        std::printf("[%08X:%08X] cvt.w.%c %u, %u; %u = %08X\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, data);
+        std::printf("[%08X:%08X] cvt.w.%c %u, %u; %u = %08X\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, (u32)data);
     }
 }
 
 template<int format>
 void DIV(const Instruction instr) {
-    if ((format != Format::Single) && (format != Format::Double)) {
-        PLOG_FATAL << "Invalid format for DIV";
+    static_assert(isFloatFormat<format>, "Invalid format for DIV");
 
-        exit(0);
-    }
+    using T = FormatType<format>;
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
     const u32 ft = instr.fType.ft;
 
-    switch (format) {
-        case Format::Single:
-            set(fd, makeWord(makeSingle(get<u32>(fs)) / makeSingle(get<u32>(ft))));
-            break;
-        case Format::Double:
-            set(fd, makeLong(makeDouble(get<u64>(fs)) / makeDouble(get<u64>(ft))));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
-
-            exit(0);
-    }
+    setFPR<T>(fd, getFPR<T>(fs) / getFPR<T>(ft));
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        f64 data = makeDouble(get<u64>(fd));
-        if (format == Format::Single) {
-            data = (f64)makeSingle(get<u32>(fd));
-        }
-
-        std::printf("[%08X:%08X] div.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, data);
+        std::printf("[%08X:%08X] div.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, (f64)getFPR<T>(fd));
     }
 }
 
 template<int format>
 void MOV(const Instruction instr) {
-    if ((format != Format::Single) && (format != Format::Double)) {
-        PLOG_FATAL << "Invalid format for MOV";
+    static_assert(isFloatFormat<format>, "Invalid format for MOV");
 
-        exit(0);
-    }
+    using T = FormatType<format>;
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
 
-    switch (format) {
-        case Format::Single:
-            set(fd, get<u32>(fs));
-            break;
-        case Format::Double:
-            set(fd, get<u64>(fs));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
-
-            exit(0);
-    }
+    setFPR<T>(fd, getFPR<T>(fs));
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        f64 data = makeDouble(get<u64>(fd));
-        if (format == Format::Single) {
-            data = (f64)makeSingle(get<u32>(fd));
-        }
-
-        std::printf("[%08X:%08X] mov.%c %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, data);
+        std::printf("[%08X:%08X] mov.%c %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, (f64)getFPR<T>(fd));
     }
 }
 
 template<int format>
 void MUL(const Instruction instr) {
-    if ((format != Format::Single) && (format != Format::Double)) {
-        PLOG_FATAL << "Invalid format for MUL";
+    static_assert(isFloatFormat<format>, "Invalid format for MUL");
 
-        exit(0);
-    }
+    using T = FormatType<format>;
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
     const u32 ft = instr.fType.ft;
 
-    switch (format) {
-        case Format::Single:
-            set(fd, makeWord(makeSingle(get<u32>(fs)) * makeSingle(get<u32>(ft))));
-            break;
-        case Format::Double:
-            set(fd, makeLong(makeDouble(get<u64>(fs)) * makeDouble(get<u64>(ft))));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
-
-            exit(0);
-    }
+    setFPR<T>(fd, getFPR<T>(fs) * getFPR<T>(ft));
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        f64 data = makeDouble(get<u64>(fd));
-        if (format == Format::Single) {
-            data = (f64)makeSingle(get<u32>(fd));
-        }
-
-        std::printf("[%08X:%08X] mul.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, data);
+        std::printf("[%08X:%08X] mul.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, (f64)getFPR<T>(fd));
     }
 }
 
 template<int format>
 void SUB(const Instruction instr) {
-    if ((format != Format::Single) && (format != Format::Double)) {
-        PLOG_FATAL << "Invalid format for SUB";
+    static_assert(isFloatFormat<format>, "Invalid format for SUB");
 
-        exit(0);
-    }
+    using T = FormatType<format>;
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
     const u32 ft = instr.fType.ft;
 
-    switch (format) {
-        case Format::Single:
-            set(fd, makeWord(makeSingle(get<u32>(fs)) - makeSingle(get<u32>(ft))));
-            break;
-        case Format::Double:
-            set(fd, makeLong(makeDouble(get<u64>(fs)) - makeDouble(get<u64>(ft))));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
-
-            exit(0);
-    }
+    setFPR<T>(fd, getFPR<T>(fs) - getFPR<T>(ft));
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        f64 data = makeDouble(get<u64>(fd));
-        if (format == Format::Single) {
-            data = (f64)makeSingle(get<u32>(fd));
-        }
-
-        std::printf("[%08X:%08X] sub.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, data);
+        std::printf("[%08X:%08X] sub.%c %u, %u, %u; %u = %lf\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, ft, fd, (f64)getFPR<T>(fd));
     }
 }
 
 template<int format>
 void TRUNCW(const Instruction instr) {
-    if ((format != Format::Single) && (format != Format::Double)) {
-        PLOG_FATAL << "Invalid format for TRUNC.W";
-
-        exit(0);
-    }
+    static_assert(isFloatFormat<format>, "Invalid format for TRUNC.W");
 
     const u32 fd = instr.fType.fd;
     const u32 fs = instr.fType.fs;
 
-    u32 data;
-    switch (format) {
-        case Format::Single:
-            data = (u32)std::trunc(makeSingle(get<u32>(fs)));
-            break;
-        case Format::Double:
-            data = (u32)std::trunc(makeDouble(get<u64>(fs)));
-            break;
-        default:
-            PLOG_FATAL << "Unimplemented format " << FORMAT_NAMES[format];
+    // Casts always round toward zero
+    const i32 data = (i32)getFPR<FormatType<format>>(fs);
 
-            exit(0);
-    }
-
-    set<u32>(fd, data);
+    setFPR<i32>(fd, data);
     
     if constexpr (ENABLE_DISASSEMBLER) {
         const u32 pc = getCurrentPC();
 
-        std::printf("[%08X:%08X] trunc.w.%c %u, %u; %u = %08X\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, data);
+        std::printf("[%08X:%08X] trunc.w.%c %u, %u; %u = %08X\n", pc, instr.raw, FORMAT_CHARS[format], fd, fs, fd, (u32)data);
     }
 }
 
@@ -666,6 +663,8 @@ void doSingle(const Instruction instr) {
     switch (funct) {
         case Opcode::ADD:
             return ADD<Format::Single>(instr);
+        case Opcode::SUB:
+            return SUB<Format::Single>(instr);
         case Opcode::MUL:
             return MUL<Format::Single>(instr);
         case Opcode::DIV:
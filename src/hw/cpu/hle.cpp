@@ -0,0 +1,423 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/cpu/hle.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <ios>
+#include <unordered_map>
+
+#include <plog/Log.h>
+
+#include "hw/cpu/cpu.hpp"
+
+#include "sys/memory.hpp"
+
+namespace hw::cpu::hle {
+
+constexpr u64 WORDS_PER_PAGE = sys::memory::PAGE_SIZE / sizeof(u32);
+
+constexpr u64 MAX_SIGNATURE_WORDS = 16;
+
+// KSEG0/KSEG1 are direct mapped
+constexpr u32 KSEG0_BASE = 0x80000000;
+constexpr u32 KSSEG_BASE = 0xC0000000;
+constexpr u32 KSEG_MASK = 0x1FFFFFFF;
+
+constexpr u64 DCACHE_SIZE = 0x2000;
+constexpr u64 DCACHE_LINE_SIZE = 16;
+
+// Signature word masks
+namespace Mask {
+    enum : u32 {
+        Full = 0xFFFFFFFF,
+        Branch = 0xFFFF0000, // Ignore branch offset
+        LoadImmediate = 0x03FFFFFF, // ADDIU or ORI
+        Move = 0xFFFFFFFB, // ADDU or OR
+    };
+}
+
+enum class Routine : u8 {
+    None,
+    Bcopy,
+    Bzero,
+    InvalDCache,
+    WritebackDCache,
+    NumberOfRoutines,
+};
+
+struct SignatureWord {
+    u32 value;
+    u32 mask;
+};
+
+struct Signature {
+    const char *name;
+    Routine routine;
+
+    u64 length;
+    SignatureWord words[MAX_SIGNATURE_WORDS];
+};
+
+// Leading instructions of the hand-written assembly routines in libultra
+constexpr Signature SIGNATURES[] = {
+    {"bcopy", Routine::Bcopy, 11, {
+        {0x00A03821, Mask::Move},   // move  a3, a1
+        {0x10C00000, Mask::Branch}, // beqz  a2, ret
+        {0x00000000, Mask::Full},
+        {0x10850000, Mask::Branch}, // beq   a0, a1, ret
+        {0x00000000, Mask::Full},
+        {0x00A4082A, Mask::Full},   // slt   at, a1, a0
+        {0x14200000, Mask::Branch}, // bnez  at, goforwards
+        {0x00000000, Mask::Full},
+        {0x00861020, Mask::Full},   // add   v0, a0, a2
+        {0x00A2082A, Mask::Full},   // slt   at, a1, v0
+        {0x10200000, Mask::Branch}, // beqz  at, goforwards
+    }},
+    {"bzero", Routine::Bzero, 8, {
+        {0x00041823, Mask::Full},   // negu  v1, a0
+        {0x28A1000C, Mask::Full},   // slti  at, a1, 12
+        {0x14200000, Mask::Branch}, // bnez  at, bytezero
+        {0x30630003, Mask::Full},   // andi  v1, v1, 3
+        {0x10600000, Mask::Branch}, // beqz  v1, blkzero
+        {0x00A32823, Mask::Full},   // subu  a1, a1, v1
+        {0xA8800000, Mask::Full},   // swl   zero, 0(a0)
+        {0x00832021, Mask::Full},   // addu  a0, a0, v1
+    }},
+    {"osInvalDCache", Routine::InvalDCache, 16, {
+        {0x18A00000, Mask::Branch}, // blez  a1, 3f
+        {0x00000000, Mask::Full},
+        {0x000B2000, Mask::LoadImmediate}, // li t3, DCACHE_SIZE
+        {0x00AB082B, Mask::Full},   // sltu  at, a1, t3
+        {0x10200000, Mask::Branch}, // beqz  at, 4f
+        {0x00000000, Mask::Full},
+        {0x00804021, Mask::Move},   // move  t0, a0
+        {0x00854821, Mask::Full},   // addu  t1, a0, a1
+        {0x0109082B, Mask::Full},   // sltu  at, t0, t1
+        {0x10200000, Mask::Branch}, // beqz  at, 3f
+        {0x00000000, Mask::Full},
+        {0x310A000F, Mask::Full},   // andi  t2, t0, DCACHE_LINEMASK
+        {0x11400000, Mask::Branch}, // beqz  t2, 1f
+        {0x2529FFF0, Mask::Full},   // addiu t1, t1, -DCACHE_LINESIZE
+        {0x010A4023, Mask::Full},   // subu  t0, t0, t2
+        {0xBD150000, Mask::Full},   // cache (C_HWBINV|CACH_PD), 0(t0)
+    }},
+    {"osWritebackDCache", Routine::WritebackDCache, 15, {
+        {0x18A00000, Mask::Branch}, // blez  a1, 2f
+        {0x00000000, Mask::Full},
+        {0x000B2000, Mask::LoadImmediate}, // li t3, DCACHE_SIZE
+        {0x00AB082B, Mask::Full},   // sltu  at, a1, t3
+        {0x10200000, Mask::Branch}, // beqz  at, 3f
+        {0x00000000, Mask::Full},
+        {0x00804021, Mask::Move},   // move  t0, a0
+        {0x00854821, Mask::Full},   // addu  t1, a0, a1
+        {0x0109082B, Mask::Full},   // sltu  at, t0, t1
+        {0x10200000, Mask::Branch}, // beqz  at, 2f
+        {0x00000000, Mask::Full},
+        {0x310A000F, Mask::Full},   // andi  t2, t0, DCACHE_LINEMASK
+        {0x2529FFF0, Mask::Full},   // addiu t1, t1, -DCACHE_LINESIZE
+        {0x010A4023, Mask::Full},   // subu  t0, t0, t2
+        {0xBD190000, Mask::Full},   // cache (C_HWB|CACH_PD), 0(t0)
+    }},
+};
+
+// Routines found in one RDRAM page
+struct PageHooks {
+    // Dirty tracking cursor, taken when the page was scanned
+    u64 cursor;
+
+    bool hasHooks;
+
+    std::array<Routine, WORDS_PER_PAGE> routines;
+};
+
+bool isHLEEnabled = false;
+
+std::unordered_map<u64, PageHooks> pageHooks;
+
+// Hooks of the page the CPU is currently executing from
+u64 currentPage;
+const PageHooks *currentHooks;
+
+void init() {}
+
+void deinit() {}
+
+void reset() {
+    pageHooks.clear();
+
+    currentPage = ~0ULL;
+    currentHooks = NULL;
+}
+
+void setEnabled(const bool isEnabled) {
+    isHLEEnabled = isEnabled;
+
+    if (isHLEEnabled) {
+        PLOG_INFO << "libultra HLE enabled";
+    }
+}
+
+bool isEnabled() {
+    return isHLEEnabled;
+}
+
+u32 loadWord(const u8 *data) {
+    u32 word;
+    std::memcpy(&word, data, sizeof(u32));
+
+    // RDRAM is stored big-endian
+    return byteswap(word);
+}
+
+// Returns true if the code at paddr matches the signature
+bool isMatch(const Signature &signature, const u64 paddr) {
+    if ((paddr + sizeof(u32) * signature.length) > sys::memory::MemorySize::RDRAM) {
+        return false;
+    }
+
+    sys::memory::materialize(paddr, sizeof(u32) * signature.length);
+
+    const u8 *code = sys::memory::getPointer(paddr);
+
+    for (u64 i = 0; i < signature.length; i++) {
+        const SignatureWord &word = signature.words[i];
+
+        if ((loadWord(&code[sizeof(u32) * i]) & word.mask) != (word.value & word.mask)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const Signature &getSignature(const Routine routine) {
+    for (const Signature &signature : SIGNATURES) {
+        if (signature.routine == routine) {
+            return signature;
+        }
+    }
+
+    PLOG_FATAL << "Unrecognized HLE routine";
+
+    exit(0);
+}
+
+const PageHooks *scanPage(const u64 page) {
+    PageHooks &hooks = pageHooks[page];
+
+    hooks.cursor = sys::memory::advanceGeneration();
+
+    const u64 pageAddr = sys::memory::pageToAddress(page);
+
+    hooks.hasHooks = false;
+
+    for (u64 i = 0; i < WORDS_PER_PAGE; i++) {
+        hooks.routines[i] = Routine::None;
+
+        for (const Signature &signature : SIGNATURES) {
+            if (isMatch(signature, pageAddr + sizeof(u32) * i)) {
+                PLOG_INFO << "Found " << signature.name << " at " << std::hex << (pageAddr + sizeof(u32) * i);
+
+                hooks.routines[i] = signature.routine;
+
+                hooks.hasHooks = true;
+                break;
+            }
+        }
+    }
+
+    return &hooks;
+}
+
+// Scans a code page the first time it is executed, and again after it has been written to
+void enterPage(const u64 page) {
+    currentPage = page;
+
+    const auto it = pageHooks.find(page);
+
+    const PageHooks *hooks;
+    if ((it == pageHooks.end()) || sys::memory::isPageDirty(page, it->second.cursor)) {
+        hooks = scanPage(page);
+    } else {
+        hooks = &it->second;
+    }
+
+    // Most pages don't contain any routine
+    currentHooks = hooks->hasHooks ? hooks : NULL;
+}
+
+// Translates a direct mapped guest range, returns false if it isn't entirely in RDRAM
+bool translateRange(const u64 vaddr, const u64 size, u64 &paddr) {
+    if (((u32)vaddr < KSEG0_BASE) || ((u32)vaddr >= KSSEG_BASE)) {
+        return false;
+    }
+
+    paddr = vaddr & KSEG_MASK;
+
+    return (paddr + size) <= sys::memory::MemorySize::RDRAM;
+}
+
+// void bcopy(const void *src, void *dst, int len)
+i64 doBcopy() {
+    const u64 src = get(Register::A0);
+    const u64 dst = get(Register::A1);
+    const u64 len = (u32)get(Register::A2);
+
+    u64 srcAddr, dstAddr;
+    if (!translateRange(src, len, srcAddr) || !translateRange(dst, len, dstAddr)) {
+        return 0;
+    }
+
+    // Let the interpreter do watched copies, so every access gets reported
+    if (sys::memory::isRangeWatched(srcAddr, len) || sys::memory::isRangeWatched(dstAddr, len)) {
+        return 0;
+    }
+
+    sys::memory::materialize(srcAddr, len);
+    sys::memory::materialize(dstAddr, len);
+
+    u8 *rdram = sys::memory::getPointer(sys::memory::MemoryBase::RDRAM);
+
+    std::memmove(&rdram[dstAddr], &rdram[srcAddr], len);
+
+    sys::memory::markDirty(dstAddr, len);
+
+    // Co-aligned copies move a word per load/store pair, everything else goes byte by byte
+    if (((srcAddr ^ dstAddr) & 3) == 0) {
+        return 20 + len / 2;
+    }
+
+    return 20 + 4 * len;
+}
+
+// void bzero(void *ptr, int len)
+i64 doBzero() {
+    const u64 ptr = get(Register::A0);
+    const u64 len = (u32)get(Register::A1);
+
+    u64 addr;
+    if (!translateRange(ptr, len, addr) || sys::memory::isRangeWatched(addr, len)) {
+        return 0;
+    }
+
+    sys::memory::materialize(addr, len);
+
+    std::memset(sys::memory::getPointer(addr), 0, len);
+
+    sys::memory::markDirty(addr, len);
+
+    // 32 bytes per 10 instruction loop iteration
+    return 16 + (10 * len) / 32;
+}
+
+// void osInvalDCache(void *vaddr, s32 nbytes), void osWritebackDCache(void *vaddr, s32 nbytes)
+i64 doDCacheMaintenance() {
+    const i32 len = get(Register::A1);
+
+    // Caches aren't emulated, only the loop over every line is left
+    if (len <= 0) {
+        return 4;
+    }
+
+    const u64 lineNum = std::min((u64)len, DCACHE_SIZE) / DCACHE_LINE_SIZE;
+
+    return 16 + 3 * lineNum;
+}
+
+// Returns the routine starting at pc, Routine::None if there is none
+Routine findRoutine(const u64 pc) {
+    if (((u32)pc < KSEG0_BASE) || ((u32)pc >= KSSEG_BASE)) {
+        return Routine::None;
+    }
+
+    const u64 paddr = pc & KSEG_MASK;
+
+    if (paddr >= sys::memory::MemorySize::RDRAM) {
+        return Routine::None;
+    }
+
+    const u64 page = sys::memory::addressToPage(paddr);
+
+    if (page != currentPage) {
+        enterPage(page);
+    }
+
+    if (currentHooks == NULL) {
+        return Routine::None;
+    }
+
+    const Routine routine = currentHooks->routines[(paddr / sizeof(u32)) % WORDS_PER_PAGE];
+
+    if (routine == Routine::None) {
+        return Routine::None;
+    }
+
+    // The page may have been overwritten since it was scanned
+    if (!isMatch(getSignature(routine), paddr)) {
+        enterPage(page);
+
+        return Routine::None;
+    }
+
+    return routine;
+}
+
+const char *getRoutineName(const u64 pc) {
+    const Routine routine = findRoutine(pc);
+
+    if (routine == Routine::None) {
+        return NULL;
+    }
+
+    return getSignature(routine).name;
+}
+
+i64 tryCall(const u64 pc) {
+    const Routine routine = findRoutine(pc);
+
+    if (routine == Routine::None) {
+        return 0;
+    }
+
+    // Execute watchpoints on the routine's entry are checked by the interpreter's fetch
+    if (sys::memory::isPageWatched(sys::memory::addressToPage(pc & KSEG_MASK))) {
+        return 0;
+    }
+
+    i64 cycles;
+    switch (routine) {
+        case Routine::Bcopy:
+            cycles = doBcopy();
+            break;
+        case Routine::Bzero:
+            cycles = doBzero();
+            break;
+        case Routine::InvalDCache:
+        case Routine::WritebackDCache:
+            cycles = doDCacheMaintenance();
+            break;
+        default:
+            PLOG_FATAL << "Unrecognized HLE routine";
+
+            exit(0);
+    }
+
+    if (cycles == 0) {
+        return 0;
+    }
+
+    PLOG_VERBOSE << "HLE " << getSignature(routine).name << " (PC = " << std::hex << pc << ")";
+
+    // Return to the caller
+    setPC(get(Register::RA));
+
+    return cycles;
+}
+
+}
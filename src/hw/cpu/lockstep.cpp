@@ -0,0 +1,216 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/cpu/lockstep.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <plog/Log.h>
+
+#include "hw/cpu/cpu.hpp"
+#include "hw/cpu/disassembler.hpp"
+#include "hw/cpu/hle.hpp"
+
+#include "sys/memory.hpp"
+#include "sys/savestate.hpp"
+
+namespace hw::cpu::lockstep {
+
+// Routines that run longer than this are assumed to never return
+constexpr i64 MAX_INSTRUCTIONS = 1 << 24;
+
+// Number of interpreted instructions shown for a divergence
+constexpr u64 TRACE_SIZE = 64;
+
+// Registers a caller can rely on after a call, everything else is scratch
+constexpr u32 PRESERVED_REGISTERS[] = {
+    Register::S0, Register::S1, Register::S2, Register::S3,
+    Register::S4, Register::S5, Register::S6, Register::S7,
+    Register::GP, Register::SP, Register::S8, Register::RA,
+};
+
+struct TraceEntry {
+    u64 pc;
+    u32 instr;
+};
+
+struct EngineResult {
+    u64 pc;
+    u64 regs[std::size(PRESERVED_REGISTERS)];
+};
+
+bool isLockstep = false;
+
+// Machine state at the start of the routine
+std::vector<u8> clone;
+
+// RDRAM after the high-level emulated routine ran, and the pages it wrote
+std::vector<u8> hleRDRAM;
+std::vector<u64> hleDirtyPages;
+
+std::vector<TraceEntry> trace;
+
+void setEnabled(const bool isEnabled) {
+    isLockstep = isEnabled;
+}
+
+bool isEnabled() {
+    return isLockstep;
+}
+
+EngineResult getResult() {
+    EngineResult result;
+    result.pc = getPC();
+
+    for (u64 i = 0; i < std::size(PRESERVED_REGISTERS); i++) {
+        result.regs[i] = get(PRESERVED_REGISTERS[i]);
+    }
+
+    return result;
+}
+
+// Reads the instruction at vaddr for the trace. Not a guest access, so it doesn't trigger watchpoints
+u32 peekInstruction(const u64 vaddr) {
+    const u64 paddr = translateAddress(vaddr);
+
+    sys::memory::materialize(paddr, sizeof(u32));
+
+    u32 instr;
+    std::memcpy(&instr, sys::memory::getPointer(paddr), sizeof(u32));
+
+    return byteswap(instr);
+}
+
+[[noreturn]] void reportDivergence(const char *name, const u64 pc) {
+    PLOG_FATAL << "Lockstep divergence in " << name << " (PC = " << std::hex << pc << ")";
+
+    std::printf("Interpreter trace (last %zu instructions):\n", trace.size());
+
+    for (const TraceEntry &entry : trace) {
+        std::printf("  %08" PRIX64 ": %08X  %s\n", (u64)(u32)entry.pc, entry.instr, disassembler::disassemble(entry.pc, entry.instr).c_str());
+    }
+
+    exit(0);
+}
+
+void compareResults(const char *name, const u64 pc, const EngineResult &hle, const u64 refCursor) {
+    const EngineResult ref = getResult();
+
+    if (hle.pc != ref.pc) {
+        std::printf("Return address differs: interpreter = %016" PRIX64 ", HLE = %016" PRIX64 "\n", ref.pc, hle.pc);
+
+        reportDivergence(name, pc);
+    }
+
+    for (u64 i = 0; i < std::size(PRESERVED_REGISTERS); i++) {
+        if (hle.regs[i] != ref.regs[i]) {
+            std::printf(
+                "Register %s differs: interpreter = %016" PRIX64 ", HLE = %016" PRIX64 "\n",
+                disassembler::getRegisterName(PRESERVED_REGISTERS[i]), ref.regs[i], hle.regs[i]
+            );
+
+            reportDivergence(name, pc);
+        }
+    }
+
+    // Pages written by either engine
+    std::vector<u64> pages = hleDirtyPages;
+    for (u64 page = 0; page < sys::memory::NUM_RDRAM_PAGES; page++) {
+        if (sys::memory::isPageDirty(page, refCursor)) {
+            pages.push_back(page);
+        }
+    }
+
+    sys::memory::materializeAll();
+
+    const u8 *rdram = sys::memory::getPointer(sys::memory::MemoryBase::RDRAM);
+
+    for (const u64 page : pages) {
+        const u64 pageAddr = sys::memory::pageToAddress(page);
+
+        for (u64 addr = pageAddr; addr < (pageAddr + sys::memory::PAGE_SIZE); addr++) {
+            if (rdram[addr] != hleRDRAM[addr]) {
+                std::printf("RDRAM differs at %06" PRIX64 ": interpreter = %02X, HLE = %02X\n", addr, rdram[addr], hleRDRAM[addr]);
+
+                reportDivergence(name, pc);
+            }
+        }
+    }
+}
+
+i64 tryCall(const u64 pc) {
+    const char *name = hle::getRoutineName(pc);
+
+    if (name == NULL) {
+        return 0;
+    }
+
+    sys::savestate::saveToBuffer(clone, sys::savestate::StateFlag::RDRAM);
+
+    const u64 returnAddress = get(Register::RA);
+
+    // Alternative engine first
+    const u64 hleCursor = sys::memory::advanceGeneration();
+
+    if (hle::tryCall(pc) == 0) {
+        // Nothing ran
+        return 0;
+    }
+
+    const EngineResult hleResult = getResult();
+
+    hleDirtyPages.clear();
+    for (u64 page = 0; page < sys::memory::NUM_RDRAM_PAGES; page++) {
+        if (sys::memory::isPageDirty(page, hleCursor)) {
+            hleDirtyPages.push_back(page);
+        }
+    }
+
+    sys::memory::materializeAll();
+
+    const u8 *rdram = sys::memory::getPointer(sys::memory::MemoryBase::RDRAM);
+    hleRDRAM.assign(rdram, rdram + sys::memory::MemorySize::RDRAM);
+
+    // Then the interpreter, from the same state
+    if (!sys::savestate::loadFromBuffer(clone, sys::savestate::StateFlag::RDRAM)) {
+        PLOG_FATAL << "Unable to restore machine state";
+
+        exit(0);
+    }
+
+    const u64 refCursor = sys::memory::advanceGeneration();
+
+    trace.clear();
+
+    i64 instructions = 0;
+    while (getPC() != returnAddress) {
+        if (instructions == MAX_INSTRUCTIONS) {
+            std::printf("Interpreter didn't return after %" PRId64 " instructions\n", instructions);
+
+            reportDivergence(name, pc);
+        }
+
+        if (trace.size() == TRACE_SIZE) {
+            trace.erase(trace.begin());
+        }
+
+        trace.push_back(TraceEntry{getPC(), peekInstruction(getPC())});
+
+        step();
+
+        instructions++;
+    }
+
+    compareResults(name, pc, hleResult, refCursor);
+
+    return instructions;
+}
+
+}
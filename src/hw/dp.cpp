@@ -12,6 +12,7 @@
 #include <plog/Log.h>
 
 #include "hw/rdp/rdp.hpp"
+#include "hw/rsp/capture.hpp"
 
 namespace hw::dp {
 
@@ -64,6 +65,10 @@ void reset() {
     std::memset(&regs, 0, sizeof(Registers));
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+}
+
 u32 readIO(const u64 ioaddr) {
     switch (ioaddr) {
         case IORegister::END:
@@ -98,7 +103,14 @@ void writeIO(const u64 ioaddr, const u32 data) {
 
             regs.end.raw = data;
 
-            regs.start.raw = rdp::processCommandList(regs.start.addr, regs.end.addr);
+            rsp::capture::onDPCommands(regs.start.addr, regs.end.addr);
+
+            // Replayed RSP tasks run without an RDP
+            if (rsp::capture::isReplaying()) {
+                regs.start.raw = regs.end.raw;
+            } else {
+                regs.start.raw = rdp::processCommandList(regs.start.addr, regs.end.addr);
+            }
             break;
         case IORegister::STATUS:
             PLOG_INFO << "STATUS write (data = " << std::hex << data << ")";
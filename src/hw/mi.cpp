@@ -13,6 +13,8 @@
 
 #include "hw/cpu/cop0.hpp"
 
+#include "sys/stats.hpp"
+
 namespace hw::mi {
 
 constexpr u32 VERSION = 0x2020102;
@@ -73,6 +75,10 @@ void reset() {
     std::memset(&regs, 0, sizeof(Registers));
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+}
+
 u32 readIO(const u64 ioaddr) {
     switch (ioaddr) {
         case IORegister::VERSION:
@@ -266,6 +272,8 @@ void requestInterrupt(const u32 source) {
 
     regs.interrupt.raw |= 1 << source;
 
+    sys::stats::counters.interrupts[source]++;
+
     setInterruptPending();
 }
 
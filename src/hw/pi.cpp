@@ -5,15 +5,20 @@
 
 #include "hw/pi.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <ios>
 
 #include <plog/Log.h>
 
+#include "hw/cart.hpp"
 #include "hw/mi.hpp"
 
+#include "sys/dma.hpp"
 #include "sys/memory.hpp"
+#include "sys/scheduler.hpp"
+#include "sys/stats.hpp"
 
 namespace hw::pi {
 
@@ -68,6 +73,14 @@ struct CARTADDR {
     u32 addr;
 };
 
+union RDLEN {
+    u32 raw;
+    struct {
+        u32 len : 24;
+        u32 : 8;
+    };
+};
+
 union WRLEN {
     u32 raw;
     struct {
@@ -89,15 +102,25 @@ union STATUS {
 struct Registers {
     DRAMADDR dramaddr;
     CARTADDR cartaddr;
+    RDLEN rdlen;
     WRLEN wrlen;
     STATUS status;
 
     Domain dom[2];
 };
 
+// Only transfers at least this large are done lazily
+constexpr u64 LAZY_DMA_MIN_SIZE = 4 * sys::memory::PAGE_SIZE;
+
 Registers regs;
 
-void init() {}
+u64 idFinishDMA;
+
+bool isLazyDMA = false;
+
+void init() {
+    idFinishDMA = sys::scheduler::registerEvent("PI DMA", [](int) { finishDMA(); });
+}
 
 void deinit() {}
 
@@ -105,6 +128,70 @@ void reset() {
     std::memset(&regs, 0, sizeof(Registers));
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+}
+
+void setLazyDMA(const bool isEnabled) {
+    isLazyDMA = isEnabled;
+}
+
+// Returns the bus timings of the domain a cartridge address belongs to
+const Domain &getDomain(const u64 cartaddr) {
+    // Domain 2 covers 0x05000000-0x05FFFFFF and 0x08000000-0x0FFFFFFF
+    if (((cartaddr >= 0x05000000) && (cartaddr < 0x06000000)) || ((cartaddr >= 0x08000000) && (cartaddr < 0x10000000))) {
+        return regs.dom[1];
+    }
+
+    return regs.dom[0];
+}
+
+// Approximates how long the PI takes to transfer len bytes, in CPU cycles
+i64 getDMACycles(const Domain &dom, const u64 len) {
+    const u64 pageSize = 1 << (dom.bsdpgs.pageSize + 2);
+    const u64 pageNum = (len + pageSize - 1) / pageSize;
+
+    // Every page starts with a latch period, then the cartridge bus moves 16 bits per pulse/release cycle
+    const u64 rcpCycles = pageNum * (dom.bsdlat.latch + 1) + ((len + 1) / 2) * ((dom.bsdpwd.pulseWidth + 1) + (dom.bsdrls.release + 1));
+
+    // The RCP runs at 2/3 of the CPU clock
+    return std::max((i64)1, (i64)((3 * rcpCycles) / 2));
+}
+
+void doDMAToCart() {
+    const u32 cartaddr = regs.cartaddr.addr;
+    const u32 dramaddr = regs.dramaddr.addr;
+    const u32 len = regs.rdlen.len + 1;
+
+    PLOG_VERBOSE << "DMA to cartridge (cart address = " << std::hex << cartaddr << ", DRAM address = " << dramaddr << ", length = " << len << ")";
+
+    if (regs.status.dmaBusy != 0) {
+        PLOG_ERROR << "PI DMA is still active";
+
+        return;
+    }
+
+    sys::dma::Transfer transfer;
+    transfer.dramaddr = dramaddr;
+    transfer.length = len;
+    transfer.count = 1;
+    transfer.skip = 0;
+
+    if (cart::mapDMA(cartaddr, true, transfer)) {
+        sys::dma::copyFromRDRAM(transfer);
+
+        cart::finishDMAWrite(cartaddr, len);
+
+        sys::stats::countDMA(sys::stats::DMAEngine::PI, len);
+    } else {
+        PLOG_WARNING << "DMA to unmapped cartridge address " << std::hex << cartaddr;
+    }
+
+    regs.status.dmaBusy = 1;
+
+    sys::scheduler::addEvent(idFinishDMA, 0, getDMACycles(getDomain(cartaddr), len));
+}
+
 void doDMAToRAM() {
     const u32 cartaddr = regs.cartaddr.addr;
     const u32 dramaddr = regs.dramaddr.addr;
@@ -112,11 +199,52 @@ void doDMAToRAM() {
 
     PLOG_VERBOSE << "DMA to RAM (cart address = " << std::hex << cartaddr << ", DRAM address = " << dramaddr << ", length = " << len << ")";
 
-    const u8 *src = sys::memory::getPointer(cartaddr);
-    u8 *dst = sys::memory::getPointer(dramaddr);
+    if (regs.status.dmaBusy != 0) {
+        PLOG_ERROR << "PI DMA is still active";
 
-    std::memcpy(dst, src, len);
+        return;
+    }
 
+    sys::dma::Transfer transfer;
+    transfer.dramaddr = dramaddr;
+    transfer.local = NULL;
+    transfer.localAddr = 0;
+    transfer.localSize = 0;
+    transfer.length = len;
+    transfer.count = 1;
+    transfer.skip = 0;
+    transfer.isLocalWrapping = false;
+
+    const u64 romSize = sys::memory::getROMSize();
+
+    const bool isROM = (cartaddr >= sys::memory::MemoryBase::CART_DOM1_A2) && (cartaddr < (sys::memory::MemoryBase::CART_DOM1_A2 + romSize));
+
+    if (isROM) {
+        transfer.local = sys::memory::getPointer(sys::memory::MemoryBase::CART_DOM1_A2);
+        transfer.localAddr = cartaddr - sys::memory::MemoryBase::CART_DOM1_A2;
+        transfer.localSize = romSize;
+    } else if (!cart::mapDMA(cartaddr, false, transfer)) {
+        PLOG_WARNING << "DMA from unmapped cartridge address " << std::hex << cartaddr;
+    }
+
+    // Large ROM transfers are only copied once RDRAM actually gets accessed
+    const bool canCopyLazily = isROM && ((transfer.localAddr + len) <= romSize) && ((dramaddr + len) <= sys::memory::MemorySize::RDRAM);
+
+    if (isLazyDMA && canCopyLazily && (len >= LAZY_DMA_MIN_SIZE)) {
+        sys::memory::copyLazy(dramaddr, &transfer.local[transfer.localAddr], len);
+    } else {
+        sys::dma::copyToRDRAM(transfer);
+    }
+
+    sys::stats::countDMA(sys::stats::DMAEngine::PI, len);
+
+    // The data is already in RDRAM, but the CPU only finds out once the transfer would have finished
+    regs.status.dmaBusy = 1;
+
+    sys::scheduler::addEvent(idFinishDMA, 0, getDMACycles(getDomain(cartaddr), len));
+}
+
+void finishDMA() {
     regs.status.dmaBusy = 0;
 
     mi::requestInterrupt(mi::InterruptSource::PI);
@@ -179,6 +307,13 @@ void writeIO(const u64 ioaddr, const u32 data) {
 
             regs.cartaddr.addr = data;
             break;
+        case IORegister::RDLEN:
+            PLOG_INFO << "RDLEN write (data = " << std::hex << data << ")";
+
+            regs.rdlen.len = data;
+
+            doDMAToCart();
+            break;
         case IORegister::WRLEN:
             PLOG_INFO << "WRLEN write (data = " << std::hex << data << ")";
 
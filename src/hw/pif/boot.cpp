@@ -0,0 +1,137 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/pif/boot.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ios>
+
+#include <plog/Log.h>
+
+#include "hw/cic.hpp"
+#include "hw/mi.hpp"
+#include "hw/pi.hpp"
+#include "hw/ri.hpp"
+#include "hw/cpu/cop0.hpp"
+#include "hw/cpu/cpu.hpp"
+#include "hw/pif/pif.hpp"
+
+#include "sys/memory.hpp"
+
+namespace hw::pif::boot {
+
+// ROM header fields
+namespace HeaderOffset {
+    constexpr u64 PIConfig = 0x00;
+    constexpr u64 EntryPoint = 0x08;
+}
+
+// Size of the ROM header + IPL3, copied to DMEM by the boot ROM
+constexpr u64 BOOT_CODE_SIZE = 0x1000;
+
+// Size of the game code IPL3 copies to RDRAM
+constexpr u64 GAME_CODE_SIZE = 0x100000;
+
+// IPL3 stores the RDRAM size here (osMemSize)
+constexpr u64 ADDR_MEM_SIZE = 0x318;
+
+// Boot ROM/IPL3 register state
+constexpr u64 IPL3_ADDRESS = 0xFFFFFFFFA4000040;
+constexpr u64 IPL3_RETURN_ADDRESS = 0xFFFFFFFFA4001550;
+constexpr u64 IPL3_STACK_POINTER = 0xFFFFFFFFA4001FF0;
+
+constexpr u64 ROM_TYPE_CARTRIDGE = 0;
+constexpr u64 TV_TYPE_NTSC = 1;
+constexpr u64 RESET_TYPE_COLD = 0;
+constexpr u64 ROM_VERSION = 0;
+
+// CU0, CU1, FR
+constexpr u32 STATUS_DEFAULT = 0x34000000;
+constexpr u32 CONFIG_DEFAULT = 0x7006E463;
+
+// RI configuration written by IPL3
+constexpr u32 RI_MODE_DEFAULT = 0xE;
+constexpr u32 RI_CONFIG_DEFAULT = 0x40;
+constexpr u32 RI_SELECT_DEFAULT = 0x14;
+constexpr u32 RI_REFRESH_DEFAULT = 0x63634;
+
+// Disables all MI interrupts
+constexpr u32 MI_MASK_DEFAULT = 0x555;
+
+void run() {
+    const u64 romSize = sys::memory::getROMSize();
+    if (romSize < BOOT_CODE_SIZE) {
+        PLOG_FATAL << "ROM is too small to boot";
+
+        exit(0);
+    }
+
+    const u32 piConfig = sys::memory::read<u32>(sys::memory::MemoryBase::CART_DOM1_A2 + HeaderOffset::PIConfig);
+    const u32 entryPoint = sys::memory::read<u32>(sys::memory::MemoryBase::CART_DOM1_A2 + HeaderOffset::EntryPoint);
+
+    PLOG_INFO << "Fast boot (entry point = " << std::hex << entryPoint << ")";
+
+    // Boot ROM: set up PI domain 1 timings from the ROM header
+    pi::writeIO(pi::IORegister::BSDDOM1LAT, (piConfig >> 0) & 0xFF);
+    pi::writeIO(pi::IORegister::BSDDOM1PWD, (piConfig >> 8) & 0xFF);
+    pi::writeIO(pi::IORegister::BSDDOM1PGS, (piConfig >> 16) & 0xF);
+    pi::writeIO(pi::IORegister::BSDDOM1RLS, (piConfig >> 20) & 0x3);
+
+    // Boot ROM: load ROM header + IPL3 into DMEM
+    std::memcpy(
+        sys::memory::getPointer(sys::memory::MemoryBase::RSP_DMEM),
+        sys::memory::getPointer(sys::memory::MemoryBase::CART_DOM1_A2),
+        BOOT_CODE_SIZE
+    );
+
+    // Put CIC seeds where the boot ROM expects them
+    const u32 seeds = hw::cic::getSeeds() & 0xFFFF;
+
+    pif::write(sys::memory::MemoryBase::PIF_RAM + pif::RAMOffset::CICSeeds, byteswap(seeds));
+
+    // IPL3: initialize RDRAM interface and MI
+    ri::writeIO(ri::IORegister::MODE, RI_MODE_DEFAULT);
+    ri::writeIO(ri::IORegister::CONFIG, RI_CONFIG_DEFAULT);
+    ri::writeIO(ri::IORegister::SELECT, RI_SELECT_DEFAULT);
+    ri::writeIO(ri::IORegister::REFRESH, RI_REFRESH_DEFAULT);
+
+    mi::writeIO(mi::IORegister::MASK, MI_MASK_DEFAULT);
+
+    // IPL3: copy the first megabyte of game code to RDRAM
+    const u64 dramaddr = entryPoint & (sys::memory::MemorySize::RDRAM - 1);
+    const u64 gameCodeSize = std::min({GAME_CODE_SIZE, romSize - BOOT_CODE_SIZE, sys::memory::MemorySize::RDRAM - dramaddr});
+
+    std::memcpy(
+        sys::memory::getPointer(dramaddr),
+        sys::memory::getPointer(sys::memory::MemoryBase::CART_DOM1_A2 + BOOT_CODE_SIZE),
+        gameCodeSize
+    );
+
+    sys::memory::markDirty(dramaddr, gameCodeSize);
+
+    sys::memory::write<u32>(ADDR_MEM_SIZE, sys::memory::MemorySize::RDRAM);
+
+    // IPL3: tell PIF-NUS the boot process is over
+    pif::write(sys::memory::MemoryBase::PIF_RAM + pif::RAMOffset::Command, byteswap((u32)pif::Command::TerminateBoot));
+
+    // Set up CPU state
+    cpu::cop0::set<u32>(cpu::cop0::Register::Status, STATUS_DEFAULT);
+    cpu::cop0::set<u32>(cpu::cop0::Register::Config, CONFIG_DEFAULT);
+
+    cpu::set<u64>(cpu::Register::T3, IPL3_ADDRESS);
+    cpu::set<u64>(cpu::Register::S3, ROM_TYPE_CARTRIDGE);
+    cpu::set<u64>(cpu::Register::S4, TV_TYPE_NTSC);
+    cpu::set<u64>(cpu::Register::S5, RESET_TYPE_COLD);
+    cpu::set<u64>(cpu::Register::S6, seeds & 0xFF);
+    cpu::set<u64>(cpu::Register::S7, ROM_VERSION);
+    cpu::set<u64>(cpu::Register::SP, IPL3_STACK_POINTER);
+    cpu::set<u64>(cpu::Register::RA, IPL3_RETURN_ADDRESS);
+
+    cpu::setPC((i64)(i32)entryPoint);
+}
+
+}
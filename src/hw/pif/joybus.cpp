@@ -5,23 +5,27 @@
 
 #include "hw/pif/joybus.hpp"
 
+#include <array>
 #include <cstdlib>
 #include <cstring>
 #include <ios>
 
 #include <plog/Log.h>
 
+#include "hw/cart.hpp"
+#include "hw/pif/pak.hpp"
+
 #include "sys/emulator.hpp"
+#include "sys/movie.hpp"
 
 namespace hw::pif::joybus {
 
-constexpr u8 NUM_CHANNELS = 5;
-
 constexpr u64 TX_BUFFER_SIZE = 64; // Arbitrary number
 
 enum class JoybusDevice {
     None,
     Controller,
+    EEPROM,
 };
 
 enum class JoybusState {
@@ -50,6 +54,8 @@ namespace JoybusCommand {
         ControllerState = 0x01,
         ReadControllerAccessory = 0x02,
         WriteControllerAccessory = 0x03,
+        ReadEEPROM = 0x04,
+        WriteEEPROM = 0x05,
     };
 }
 
@@ -61,10 +67,33 @@ namespace ControllerIdentifier {
 
 namespace ControllerStatus {
     enum : u8 {
+        PakInserted = 1 << 0,
         NoControllerPak = 1 << 1,
     };
 }
 
+// CRC-8 (polynomial 0x85) lookup table for accessory data
+constexpr std::array<u8, 256> CRC_TABLE = [] {
+    constexpr u8 POLYNOMIAL = 0x85;
+
+    std::array<u8, 256> table{};
+
+    for (int i = 0; i < 256; i++) {
+        u8 crc = i;
+        for (int j = 0; j < 8; j++) {
+            if ((crc & (1 << 7)) != 0) {
+                crc = (crc << 1) ^ POLYNOMIAL;
+            } else {
+                crc <<= 1;
+            }
+        }
+
+        table[i] = crc;
+    }
+
+    return table;
+}();
+
 struct JoybusChannel {
     JoybusDevice device;
 };
@@ -82,6 +111,16 @@ bool isFirstAccess;
 
 JoybusState state;
 
+int controllerNum = 1;
+
+void setControllerNum(const int num) {
+    controllerNum = num;
+}
+
+int getControllerNum() {
+    return controllerNum;
+}
+
 void init() {}
 
 void deinit() {}
@@ -91,9 +130,15 @@ void reset() {
         channel.device = JoybusDevice::None;
     }
 
-    // Add one controller
-    channels[0].device = JoybusDevice::Controller;
-    
+    for (int channel = 0; channel < controllerNum; channel++) {
+        channels[channel].device = JoybusDevice::Controller;
+    }
+
+    // Cartridge EEPROM sits on channel 4
+    if (cart::hasEEPROM()) {
+        channels[4].device = JoybusDevice::EEPROM;
+    }
+
     activeChannel = NULL;
 
     isFirstAccess = true;
@@ -103,6 +148,32 @@ void reset() {
     state = JoybusState::ReceiveCommand;
 }
 
+void doSavestate(sys::savestate::State &savestate) {
+    savestate.doPOD(channels);
+
+    // Store the active channel as an index
+    u8 activeChannelIdx = NUM_CHANNELS;
+    if (activeChannel != NULL) {
+        activeChannelIdx = activeChannel - channels;
+    }
+
+    savestate.doPOD(activeChannelIdx);
+
+    if (savestate.isLoading()) {
+        activeChannel = NULL;
+        if (activeChannelIdx < NUM_CHANNELS) {
+            activeChannel = &channels[activeChannelIdx];
+        }
+    }
+
+    savestate.doPOD(currentChannel);
+    savestate.doPOD(txPointer);
+    savestate.doPOD(dataSize);
+    savestate.doPOD(txBuffer);
+    savestate.doPOD(isFirstAccess);
+    savestate.doPOD(state);
+}
+
 void resetTXBuffer() {
     txPointer = dataSize = 0;
 
@@ -132,26 +203,9 @@ void setActiveChannel(const u8 channel) {
 }
 
 u8 calculateCRC(const u8 *data) {
-    constexpr u8 POLYNOMIAL = 0x85;
-
     u8 crc = 0;
-    for (int i = 0; i <= 32; i++) {
-        for (int j = 7; j >= 0; j--) {
-            u8 mask = 0;
-            if ((crc & (1 << 7)) != 0) {
-                mask = POLYNOMIAL;
-            }
-
-            crc <<= 1;
-
-            if (i != 32) {
-                if ((data[i] & (1 << j)) != 0) {
-                    crc |= 1;
-                }
-            }
-
-            crc ^= mask;
-        }
+    for (u64 i = 0; i < pak::BLOCK_SIZE; i++) {
+        crc = CRC_TABLE[crc ^ data[i]];
     }
 
     return crc;
@@ -173,6 +227,12 @@ void doCommand() {
         case JoybusCommand::WriteControllerAccessory:
             prepareReceiveData(34); // Two address bytes, 32 data bytes
             break;
+        case JoybusCommand::ReadEEPROM:
+            prepareReceiveData(1); // Block number
+            break;
+        case JoybusCommand::WriteEEPROM:
+            prepareReceiveData(9); // Block number, 8 data bytes
+            break;
         default:
             PLOG_FATAL << "Unrecognized Joybus command " << std::hex << (u16)command << " (channel = " << (u16)currentChannel << ")";
 
@@ -180,7 +240,69 @@ void doCommand() {
     }
 }
 
-void cmdControllerState() {
+void resetChannel(const u8 channel) {
+    if ((channel < NUM_CHANNELS) && (channels[channel].device == JoybusDevice::Controller)) {
+        pak::resetPak(channel);
+    }
+}
+
+u8 runCommand(const u8 channel, const u8 *tx, const u8 txLength, u8 *rx, const u8 rxLength) {
+    if ((txLength == 0) || (txLength > TX_BUFFER_SIZE) || (rxLength > TX_BUFFER_SIZE)) {
+        PLOG_ERROR << "Invalid Joybus transfer (TX length = " << (u16)txLength << ", RX length = " << (u16)rxLength << ")";
+
+        return TransferStatus::Error;
+    }
+
+    setActiveChannel(channel);
+
+    if (activeChannel->device == JoybusDevice::None) {
+        return TransferStatus::NoResponse;
+    }
+
+    std::memcpy(txBuffer, tx, txLength);
+
+    txPointer = txLength;
+
+    const u8 command = txBuffer[0];
+
+    bool isHandled;
+    switch (command) {
+        case JoybusCommand::Info:
+            isHandled = cmdInfo();
+            break;
+        case JoybusCommand::ControllerState:
+            isHandled = cmdControllerState();
+            break;
+        case JoybusCommand::ReadControllerAccessory:
+            isHandled = cmdReadControllerAccessory();
+            break;
+        case JoybusCommand::WriteControllerAccessory:
+            isHandled = cmdWriteControllerAccessory();
+            break;
+        case JoybusCommand::ReadEEPROM:
+            isHandled = cmdReadEEPROM();
+            break;
+        case JoybusCommand::WriteEEPROM:
+            isHandled = cmdWriteEEPROM();
+            break;
+        default:
+            // Games probe for devices with commands we don't know, don't stop emulation over it
+            PLOG_WARNING << "Unrecognized Joybus command " << std::hex << (u16)command << " (channel = " << (u16)currentChannel << ")";
+
+            return TransferStatus::Error;
+    }
+
+    // Valid command, but not one the device on this channel knows
+    if (!isHandled) {
+        return TransferStatus::NoResponse;
+    }
+
+    std::memcpy(rx, txBuffer, rxLength);
+
+    return TransferStatus::OK;
+}
+
+bool cmdControllerState() {
     PLOG_VERBOSE << "Controller State (channel = " << (u16)currentChannel << ")";
 
     resetTXBuffer();
@@ -190,19 +312,22 @@ void cmdControllerState() {
             {
                 PLOG_DEBUG << "Channel " << (u16)currentChannel << " is standard controller";
 
-                const u32 buttonState = sys::emulator::getButtonState();
+                // Only the first controller is mapped to the keyboard
+                if (currentChannel == 0) {
+                    const u32 buttonState = sys::movie::pollController(sys::emulator::getButtonState());
 
-                std::memcpy(txBuffer, &buttonState, sizeof(u32));
+                    std::memcpy(txBuffer, &buttonState, sizeof(u32));
+                }
             }
-            break;
+            return true;
         default:
-            PLOG_FATAL << "Unrecognized Joybus device";
+            PLOG_WARNING << "Channel " << (u16)currentChannel << " doesn't respond to Controller State";
 
-            exit(0);
+            return false;
     }
 }
 
-void cmdInfo() {
+bool cmdInfo() {
     PLOG_VERBOSE << "Info (channel = " << (u16)currentChannel << ")";
 
     resetTXBuffer();
@@ -215,59 +340,124 @@ void cmdInfo() {
             PLOG_DEBUG << "Channel " << (u16)currentChannel << " is standard controller";
 
             id = ControllerIdentifier::Controller;
-            status = ControllerStatus::NoControllerPak;
+            status = pak::isInserted(currentChannel) ? ControllerStatus::PakInserted : ControllerStatus::NoControllerPak;
             break;
+        case JoybusDevice::EEPROM:
+            PLOG_DEBUG << "Channel " << (u16)currentChannel << " is EEPROM";
+
+            // EEPROM identifiers are sent big-endian
+            txBuffer[0] = cart::getEEPROMIdentifier() >> 8;
+            txBuffer[1] = cart::getEEPROMIdentifier();
+            txBuffer[2] = 0;
+            return true;
         default:
-            PLOG_FATAL << "Unrecognized Joybus device";
+            PLOG_WARNING << "Channel " << (u16)currentChannel << " doesn't respond to Info";
 
-            exit(0);
+            return false;
     }
 
     std::memcpy(txBuffer, &id, sizeof(u16));
 
     txBuffer[2] = status;
+
+    return true;
 }
 
-void cmdReadControllerAccessory() {
-    PLOG_VERBOSE << "Read Controller Accessory (channel = " << (u16)currentChannel << ")";
+bool cmdReadControllerAccessory() {
+    const u16 addr = (txBuffer[1] << 8) | txBuffer[2];
 
-    // TODO: read address
+    PLOG_VERBOSE << "Read Controller Accessory (channel = " << (u16)currentChannel << ", address = " << std::hex << addr << ")";
 
     resetTXBuffer();
 
     switch (activeChannel->device) {
         case JoybusDevice::Controller:
             PLOG_DEBUG << "Channel " << (u16)currentChannel << " is standard controller";
-            PLOG_ERROR << "No Controller Pak inserted";
+
+            if (pak::isInserted(currentChannel)) {
+                pak::readBlock(currentChannel, addr, txBuffer);
+            } else {
+                PLOG_ERROR << "No Controller Pak inserted";
+            }
             break;
         default:
-            PLOG_FATAL << "Unrecognized Joybus device";
+            PLOG_WARNING << "Channel " << (u16)currentChannel << " doesn't respond to Read Controller Accessory";
 
-            exit(0);
+            return false;
     }
 
     txBuffer[32] = calculateCRC(txBuffer);
+
+    return true;
 }
 
-void cmdWriteControllerAccessory() {
-    PLOG_VERBOSE << "Write Controller Accessory (channel = " << (u16)currentChannel << ")";
+bool cmdWriteControllerAccessory() {
+    const u16 addr = (txBuffer[1] << 8) | txBuffer[2];
 
-    const u8 crc = calculateCRC(&txBuffer[3]);
+    PLOG_VERBOSE << "Write Controller Accessory (channel = " << (u16)currentChannel << ", address = " << std::hex << addr << ")";
 
-    resetTXBuffer();
+    const u8 crc = calculateCRC(&txBuffer[3]);
 
     switch (activeChannel->device) {
         case JoybusDevice::Controller:
             PLOG_DEBUG << "Channel " << (u16)currentChannel << " is standard controller";
-            PLOG_WARNING << "No Controller Pak inserted";
+
+            if (pak::isInserted(currentChannel)) {
+                pak::writeBlock(currentChannel, addr, &txBuffer[3]);
+            } else {
+                PLOG_WARNING << "No Controller Pak inserted";
+            }
             break;
         default:
-            PLOG_FATAL << "Unrecognized Joybus device";
+            PLOG_WARNING << "Channel " << (u16)currentChannel << " doesn't respond to Write Controller Accessory";
 
-            exit(0);
+            return false;
     }
 
+    resetTXBuffer();
+
     txBuffer[0] = crc;
+
+    return true;
+}
+
+bool cmdReadEEPROM() {
+    const u8 block = txBuffer[1];
+
+    PLOG_VERBOSE << "Read EEPROM (channel = " << (u16)currentChannel << ", block = " << (u16)block << ")";
+
+    resetTXBuffer();
+
+    if (activeChannel->device != JoybusDevice::EEPROM) {
+        PLOG_WARNING << "Channel " << (u16)currentChannel << " is not EEPROM";
+
+        return false;
+    }
+
+    cart::readEEPROM(block, txBuffer);
+
+    return true;
+}
+
+bool cmdWriteEEPROM() {
+    const u8 block = txBuffer[1];
+
+    PLOG_VERBOSE << "Write EEPROM (channel = " << (u16)currentChannel << ", block = " << (u16)block << ")";
+
+    if (activeChannel->device != JoybusDevice::EEPROM) {
+        PLOG_WARNING << "Channel " << (u16)currentChannel << " is not EEPROM";
+
+        return false;
+    }
+
+    cart::writeEEPROM(block, &txBuffer[2]);
+
+    resetTXBuffer();
+
+    // Busy flag
+    txBuffer[0] = 0;
+
+    return true;
 }
 
 u8 readChannel() {
@@ -352,6 +542,12 @@ void writeTransmit(const u8 data) {
                         case JoybusCommand::WriteControllerAccessory:
                             cmdWriteControllerAccessory();
                             break;
+                        case JoybusCommand::ReadEEPROM:
+                            cmdReadEEPROM();
+                            break;
+                        case JoybusCommand::WriteEEPROM:
+                            cmdWriteEEPROM();
+                            break;
                         default:
                             PLOG_FATAL << "Unrecognized Joybus command " << std::hex << (u16)command << " (channel = " << (u16)currentChannel << ")";
 
@@ -19,6 +19,11 @@ std::array<u8, MemorySize::RAM> ram;
 std::array<u8, MemorySize::ROM> rom;
 
 void init(const char *pifPath) {
+    // Not needed if PIF-NUS is high-level emulated
+    if (pifPath == NULL) {
+        return;
+    }
+
     // Read PIF-NUS ROM
     FILE *file = std::fopen(pifPath, "rb");
     if (file == NULL) {
@@ -46,6 +51,10 @@ u8 read(const u16 paddr) {
     exit(0);
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(ram);
+}
+
 u8 readRAM(const u8 paddr) {
     const u8 addr = paddr >> 1;
     const u8 nibble = (paddr & 1) ^ 1;
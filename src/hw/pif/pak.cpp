@@ -0,0 +1,228 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/pif/pak.hpp"
+
+#include <cstring>
+#include <string>
+
+#include <plog/Log.h>
+
+#include "hw/pif/joybus.hpp"
+
+#include "sys/savefile.hpp"
+
+namespace hw::pif::pak {
+
+constexpr u64 CONTROLLER_PAK_SIZE = 0x8000;
+
+constexpr u16 ADDRESS_MASK = ~(u16)0x1F;
+
+// Accessory address ranges
+namespace PakAddress {
+    enum : u16 {
+        Probe = 0x8000,
+        Motor = 0xC000,
+    };
+}
+
+// Rumble Paks answer probes with this value
+constexpr u8 RUMBLE_PAK_ID = 0x80;
+
+struct Pak {
+    sys::savefile::SaveFile *file;
+    u8 *data;
+
+    bool isRumbling;
+};
+
+struct PakTypeName {
+    const char *name;
+    PakType type;
+};
+
+// Pak type names as used on the command line
+constexpr PakTypeName PAK_TYPE_NAMES[] = {
+    {"none", PakType::None},
+    {"controller", PakType::ControllerPak},
+    {"rumble", PakType::RumblePak},
+};
+
+PakType pakType = PakType::None;
+
+Pak paks[joybus::MAX_CONTROLLERS];
+
+void setPakType(const PakType type) {
+    pakType = type;
+}
+
+PakType getPakType() {
+    return pakType;
+}
+
+const char *getPakTypeName(const PakType type) {
+    for (const PakTypeName &pakTypeName : PAK_TYPE_NAMES) {
+        if (pakTypeName.type == type) {
+            return pakTypeName.name;
+        }
+    }
+
+    return "unknown";
+}
+
+bool parsePakType(const char *name, PakType &type) {
+    for (const PakTypeName &pakTypeName : PAK_TYPE_NAMES) {
+        if (std::strcmp(name, pakTypeName.name) == 0) {
+            type = pakTypeName.type;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void init(const char *romPath) {
+    for (Pak &pak : paks) {
+        pak.file = NULL;
+        pak.data = NULL;
+    }
+
+    if (pakType != PakType::ControllerPak) {
+        return;
+    }
+
+    // One Controller Pak file per connected controller
+    for (u8 channel = 0; channel < joybus::getControllerNum(); channel++) {
+        const std::string pakPath = std::string(romPath) + ".mpk" + std::to_string(channel + 1);
+
+        paks[channel].file = sys::savefile::open(pakPath.c_str(), CONTROLLER_PAK_SIZE, 0);
+        paks[channel].data = sys::savefile::getData(paks[channel].file);
+    }
+}
+
+void deinit() {
+    for (Pak &pak : paks) {
+        if (pak.file != NULL) {
+            sys::savefile::close(pak.file);
+
+            pak.file = NULL;
+            pak.data = NULL;
+        }
+    }
+}
+
+void reset() {
+    for (Pak &pak : paks) {
+        pak.isRumbling = false;
+    }
+}
+
+void resetPak(const u8 channel) {
+    if (channel < joybus::MAX_CONTROLLERS) {
+        paks[channel].isRumbling = false;
+    }
+}
+
+void doSavestate(sys::savestate::State &state) {
+    for (Pak &pak : paks) {
+        state.doPOD(pak.isRumbling);
+
+        sys::savefile::doSavestate(state, pak.file);
+    }
+}
+
+bool isInserted(const u8 channel) {
+    return (pakType != PakType::None) && (channel < joybus::getControllerNum());
+}
+
+bool isAddressValid(const u16 addr) {
+    constexpr u8 POLYNOMIAL = 0x15;
+
+    // CRC-5 of the upper 11 address bits
+    u8 crc = 0;
+    for (int i = 15; i >= 5; i--) {
+        const bool isMSBSet = (crc & (1 << 4)) != 0;
+
+        crc = ((crc << 1) | ((addr >> i) & 1)) & 0x1F;
+
+        if (isMSBSet) {
+            crc ^= POLYNOMIAL;
+        }
+    }
+
+    for (int i = 0; i < 5; i++) {
+        const bool isMSBSet = (crc & (1 << 4)) != 0;
+
+        crc = (crc << 1) & 0x1F;
+
+        if (isMSBSet) {
+            crc ^= POLYNOMIAL;
+        }
+    }
+
+    return crc == (addr & 0x1F);
+}
+
+void readBlock(const u8 channel, const u16 addr, u8 *data) {
+    if (!isAddressValid(addr)) {
+        PLOG_WARNING << "Pak address CRC mismatch (channel = " << (u16)channel << ", address = " << std::hex << addr << ")";
+    }
+
+    const u16 blockAddr = addr & ADDRESS_MASK;
+
+    switch (pakType) {
+        case PakType::ControllerPak:
+            if (blockAddr < CONTROLLER_PAK_SIZE) {
+                std::memcpy(data, &paks[channel].data[blockAddr], BLOCK_SIZE);
+            } else {
+                std::memset(data, 0, BLOCK_SIZE);
+            }
+            break;
+        case PakType::RumblePak:
+            if ((blockAddr >= PakAddress::Probe) && (blockAddr < PakAddress::Motor)) {
+                std::memset(data, RUMBLE_PAK_ID, BLOCK_SIZE);
+            } else {
+                std::memset(data, 0, BLOCK_SIZE);
+            }
+            break;
+        default:
+            std::memset(data, 0, BLOCK_SIZE);
+            break;
+    }
+}
+
+void writeBlock(const u8 channel, const u16 addr, const u8 *data) {
+    if (!isAddressValid(addr)) {
+        PLOG_WARNING << "Pak address CRC mismatch (channel = " << (u16)channel << ", address = " << std::hex << addr << ")";
+    }
+
+    const u16 blockAddr = addr & ADDRESS_MASK;
+
+    switch (pakType) {
+        case PakType::ControllerPak:
+            if (blockAddr < CONTROLLER_PAK_SIZE) {
+                std::memcpy(&paks[channel].data[blockAddr], data, BLOCK_SIZE);
+
+                sys::savefile::markDirty(paks[channel].file, blockAddr, BLOCK_SIZE);
+            }
+            break;
+        case PakType::RumblePak:
+            if (blockAddr >= PakAddress::Motor) {
+                const bool isRumbling = data[BLOCK_SIZE - 1] != 0;
+
+                if (isRumbling != paks[channel].isRumbling) {
+                    PLOG_DEBUG << "Rumble Pak motor " << (isRumbling ? "on" : "off") << " (channel = " << (u16)channel << ")";
+                }
+
+                paks[channel].isRumbling = isRumbling;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+}
@@ -11,18 +11,55 @@
 
 #include <plog/Log.h>
 
+#include "hw/cic.hpp"
 #include "hw/sm5.hpp"
+#include "hw/pif/joybus.hpp"
 #include "hw/pif/memory.hpp"
 
 #include "sys/memory.hpp"
+#include "sys/perf.hpp"
+#include "sys/scheduler.hpp"
 
 namespace hw::pif {
 
 using sm5::SM5;
 
+// Joybus command block markers
+namespace JoybusMarker {
+    enum : u8 {
+        SkipChannel = 0x00,
+        ResetChannel = 0xFD,
+        End = 0xFE,
+        Padding = 0xFF,
+    };
+}
+
+constexpr u8 LENGTH_MASK = 0x3F;
+
+// PIF-NUS runs at 1/6 of the CPU clock
+constexpr i64 CLOCK_DIVIDER = 6;
+
+// Number of CPU cycles PIF-NUS runs for before checking for standby mode
+constexpr i64 RUN_CYCLES = 4096;
+
 SM5 pifNUS;
 
-void init() {
+bool useHLE;
+
+u64 idRunPIFNUS;
+
+// True if PIF-NUS is awake and has a scheduled run
+bool isScheduled;
+
+void init(const bool isHLE) {
+    useHLE = isHLE;
+
+    if (useHLE) {
+        PLOG_INFO << "PIF-NUS is high-level emulated";
+    }
+
+    idRunPIFNUS = sys::scheduler::registerEvent("PIF-NUS", [](int) { runPIFNUS(); });
+
     pifNUS.read = &memory::read;
     pifNUS.readRAM = &memory::readRAM;
     pifNUS.write = &memory::write;
@@ -33,10 +70,169 @@ void deinit() {}
 
 void reset() {
     pifNUS.reset();
+
+    isScheduled = false;
+
+    if (useHLE) {
+        // PIF-NUS normally gets these from the CIC while booting
+        const u32 seeds = hw::cic::getSeeds() & 0xFFFF;
+
+        write(sys::memory::MemoryBase::PIF_RAM + RAMOffset::CICSeeds, byteswap(seeds));
+    } else {
+        wake();
+    }
+}
+
+void doSavestate(sys::savestate::State &state) {
+    pifNUS.doSavestate(state);
+
+    state.doPOD(isScheduled);
+}
+
+bool isHLE() {
+    return useHLE;
+}
+
+u8 *getRAM() {
+    return (u8 *)memory::getRAMPointer(sys::memory::MemorySize::PIF_RAM);
+}
+
+void runJoybus() {
+    u8 *ram = getRAM();
+
+    u64 idx = 0;
+    u8 channel = 0;
+
+    while ((idx < (sys::memory::MemorySize::PIF_RAM - 1)) && (channel < joybus::NUM_CHANNELS)) {
+        const u8 txLength = ram[idx];
+
+        switch (txLength) {
+            case JoybusMarker::End:
+                return;
+            case JoybusMarker::Padding:
+                idx++;
+                continue;
+            case JoybusMarker::ResetChannel:
+                joybus::resetChannel(channel);
+
+                idx++;
+                channel++;
+                continue;
+            case JoybusMarker::SkipChannel:
+                idx++;
+                channel++;
+                continue;
+            default:
+                break;
+        }
+
+        const u8 rxLength = ram[idx + 1] & LENGTH_MASK;
+
+        const u64 txIdx = idx + 2;
+        const u64 rxIdx = txIdx + (txLength & LENGTH_MASK);
+
+        if ((rxIdx + rxLength) > (sys::memory::MemorySize::PIF_RAM - 1)) {
+            PLOG_ERROR << "Joybus command block overflows PIF RAM";
+
+            return;
+        }
+
+        ram[idx + 1] |= joybus::runCommand(channel, &ram[txIdx], txLength & LENGTH_MASK, &ram[rxIdx], rxLength);
+
+        idx = rxIdx + rxLength;
+        channel++;
+    }
+}
+
+// Passes the challenge in PIF RAM to the CIC (only CIC-NUS-6105 games issue one), replaces it with the response
+void doChallenge() {
+    u8 *challengeData = &getRAM()[RAMOffset::Challenge];
+
+    u8 challenge[cic::CHALLENGE_LENGTH], response[cic::CHALLENGE_LENGTH];
+
+    // Two nibbles per byte, high nibble first
+    for (u64 i = 0; i < (cic::CHALLENGE_LENGTH / 2); i++) {
+        challenge[2 * i + 0] = challengeData[i] >> 4;
+        challenge[2 * i + 1] = challengeData[i] & 0xF;
+    }
+
+    cic::respondToChallenge(challenge, response);
+
+    getRAM()[RAMOffset::ChallengeStatus + 0] = 0;
+    getRAM()[RAMOffset::ChallengeStatus + 1] = 0;
+
+    for (u64 i = 0; i < (cic::CHALLENGE_LENGTH / 2); i++) {
+        challengeData[i] = (response[2 * i + 0] << 4) | response[2 * i + 1];
+    }
+}
+
+void processCommands() {
+    sys::perf::ScopedPhase phase(sys::perf::Phase::PIF);
+
+    u8 &command = getRAM()[sys::memory::MemorySize::PIF_RAM - 1];
+
+    if ((command & Command::RunJoybus) != 0) {
+        runJoybus();
+
+        command &= ~Command::RunJoybus;
+    }
+
+    if ((command & Command::ChallengeCIC) != 0) {
+        doChallenge();
+
+        command &= ~Command::ChallengeCIC;
+    }
+
+    if ((command & Command::TerminateBoot) != 0) {
+        PLOG_INFO << "Boot process terminated";
+
+        command &= ~Command::TerminateBoot;
+    }
+
+    if ((command & Command::LockBootROM) != 0) {
+        command &= ~Command::LockBootROM;
+    }
+
+    if ((command & Command::AcquireChecksum) != 0) {
+        command &= ~Command::AcquireChecksum;
+        command |= Command::ChecksumAcquired;
+    }
+
+    if ((command & Command::ClearRAM) != 0) {
+        std::memset(getRAM(), 0, sys::memory::MemorySize::PIF_RAM);
+    }
+}
+
+// Schedules PIF-NUS if it isn't scheduled yet
+void wake() {
+    if (isScheduled || useHLE) {
+        return;
+    }
+
+    isScheduled = true;
+
+    sys::scheduler::addEvent(idRunPIFNUS, 0, RUN_CYCLES);
+}
+
+// Catches PIF-NUS up, keeps it scheduled until it enters standby mode
+void runPIFNUS() {
+    sys::perf::ScopedPhase phase(sys::perf::Phase::PIF);
+
+    isScheduled = false;
+
+    pifNUS.run(RUN_CYCLES / CLOCK_DIVIDER);
+
+    if (!pifNUS.isInStandby()) {
+        wake();
+    }
 }
 
 void setInterruptAPending() {
     pifNUS.setInterruptAPending();
+
+    if (!pifNUS.isInStandby()) {
+        wake();
+    }
 }
 
 void setRCPPort(const bool isRead, const bool is64B) {
@@ -70,10 +266,25 @@ void write(const u64 paddr, const u32 data) {
     // PLOG_VERBOSE << "PIF RAM write (address = " << std::hex << paddr << ", data = " << data << ")";
 
     std::memcpy(memory::getRAMPointer(paddr - sys::memory::MemoryBase::PIF_RAM + sys::memory::MemorySize::PIF_RAM), &data, sizeof(u32));
+
+    // PIF-NUS would pick up commands written by the CPU on its own
+    if (useHLE && (paddr == (sys::memory::MemoryBase::PIF_RAM + RAMOffset::Command))) {
+        processCommands();
+    }
 }
 
 void run(const i64 cycles) {
-    pifNUS.run(cycles);
+    if (useHLE) {
+        return;
+    }
+
+    sys::perf::ScopedPhase phase(sys::perf::Phase::PIF);
+
+    pifNUS.run(cycles / CLOCK_DIVIDER);
+
+    if (!pifNUS.isInStandby()) {
+        wake();
+    }
 }
 
 }
@@ -13,6 +13,7 @@
 #include <plog/Log.h>
 
 #include "sys/memory.hpp"
+#include "sys/stats.hpp"
 
 namespace hw::rdp::rasterizer {
 
@@ -201,6 +202,11 @@ void reset() {
     std::memset(&ctx, 0, sizeof(Context));
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(ctx);
+    state.doPOD(tmem);
+}
+
 template<>
 u64 readTMEM<Size::_4BPP>(const u64 tmemAddr, const u64 x, const u64 y, const u64 width) {
     const u64 tmemIndex = width * y + (x / 16);
@@ -367,6 +373,10 @@ void fillRectangle(const u64 x0, const u64 y0, const u64 x1, const u64 y1) {
             sys::memory::write(ctx.colorImage.dramaddr + 2 * (ctx.colorImage.width * y + x), fillColor);
         }
     }
+
+    if (((x1 >> 2) > (x0 >> 2)) && ((y1 >> 2) > (y0 >> 2))) {
+        sys::stats::counters.pixels += ((x1 >> 2) - (x0 >> 2)) * ((y1 >> 2) - (y0 >> 2));
+    }
 }
 
 void textureRectangle(TextureRectangleHeader header, TextureRectangleParameters params) {
@@ -462,6 +472,17 @@ void textureRectangle(TextureRectangleHeader header, TextureRectangleParameters
 
         v = ((v << 5) + dtdy) >> 5;
     }
+
+    // One texel per pixel, palette lookups aren't counted
+    const u64 x0 = header.x0 >> 2;
+    const u64 y0 = header.y0 >> 2;
+    const u64 x1 = header.x1 >> 2;
+    const u64 y1 = header.y1 >> 2;
+
+    if ((x1 > x0) && (y1 > y0)) {
+        sys::stats::counters.pixels += (x1 - x0) * (y1 - y0);
+        sys::stats::counters.texels += (x1 - x0) * (y1 - y0);
+    }
 }
 
 void loadTile(const u64 tileIndex, const u64 x0, const u64 y0, const u64 x1, const u64 y1) {
@@ -15,6 +15,8 @@
 #include "hw/rdp/rasterizer.hpp"
 
 #include "sys/memory.hpp"
+#include "sys/perf.hpp"
+#include "sys/stats.hpp"
 
 namespace hw::rdp {
 
@@ -95,6 +97,8 @@ void deinit() {}
 void reset() {}
 
 u64 processCommandList(const u64 startAddr, const u64 endAddr) {
+    sys::perf::ScopedPhase phase(sys::perf::Phase::RDP);
+
     PLOG_VERBOSE << "RDP command list (start address = " << std::hex << startAddr << ", end address = " << endAddr << ")";
 
     if (startAddr >= endAddr) {
@@ -110,6 +114,9 @@ u64 processCommandList(const u64 startAddr, const u64 endAddr) {
         const u64 data = sys::memory::read<u64>(addr);
 
         const u64 command = (data >> 56) & 0x3F;
+
+        sys::stats::counters.rdpCommands[command]++;
+
         switch (command) {
             case Command::TextureRectangle:
                 addr += 8;
@@ -156,6 +156,11 @@ void reset() {
     std::memset(&regs, 0, sizeof(Registers));
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(modules);
+    state.doPOD(regs);
+}
+
 u64 getRDRAMAddress(const u64 ioaddr) {
     const u64 addrLo = ioaddr & 0x3FF;
     const u64 addrHi = (ioaddr >> 10) & 0x1FF;
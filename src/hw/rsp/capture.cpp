@@ -0,0 +1,351 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/rsp/capture.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_set>
+
+#include <plog/Log.h>
+
+#include "hw/dp.hpp"
+#include "hw/sp.hpp"
+#include "hw/rsp/rsp.hpp"
+
+#include "sys/memory.hpp"
+#include "sys/savestate.hpp"
+#include "sys/scheduler.hpp"
+
+namespace hw::rsp::capture {
+
+namespace MemoryBase = sys::memory::MemoryBase;
+namespace MemorySize = sys::memory::MemorySize;
+
+// "S64R"
+constexpr u32 MAGIC = 0x52343653;
+
+// Has to be incremented every time the capture layout changes
+constexpr u32 VERSION = 1;
+
+// "TASK"
+constexpr u32 TASK_MAGIC = 0x4B534154;
+
+// Upper bounds, used to reject corrupt captures
+constexpr u64 MAX_STATE_SIZE = 0x100000;
+constexpr u64 MAX_OUTPUTS = 0x100000;
+
+constexpr u64 FNV_OFFSET_BASIS = 0xCBF29CE484222325;
+constexpr u64 FNV_PRIME = 0x100000001B3;
+
+const char *capturePath = NULL;
+
+FILE *captureFile = NULL;
+
+bool isTaskRunning = false;
+bool isReplay = false;
+
+Task currentTask;
+
+// RDRAM pages already stored in the current task
+std::unordered_set<u64> capturedPages;
+
+void setPath(const char *path) {
+    capturePath = path;
+}
+
+void init() {
+    if (capturePath == NULL) {
+        return;
+    }
+
+    captureFile = std::fopen(capturePath, "wb");
+    if (captureFile == NULL) {
+        PLOG_FATAL << "Unable to open RSP capture file";
+
+        exit(0);
+    }
+
+    const u32 header[] = {MAGIC, VERSION};
+    std::fwrite(header, sizeof(header), 1, captureFile);
+
+    PLOG_INFO << "Capturing RSP tasks to " << capturePath;
+}
+
+void deinit() {
+    if (captureFile != NULL) {
+        std::fclose(captureFile);
+
+        captureFile = NULL;
+    }
+
+    isTaskRunning = false;
+    isReplay = false;
+}
+
+bool isReplaying() {
+    return isReplay;
+}
+
+// Everything the RSP can see except for RDRAM
+void doTaskState(sys::savestate::State &state) {
+    rsp::doSavestate(state);
+    sp::doSavestate(state);
+    dp::doSavestate(state);
+
+    state.doBytes(sys::memory::getPointer(MemoryBase::RSP_IMEM), MemorySize::RSP_IMEM);
+    state.doBytes(sys::memory::getPointer(MemoryBase::RSP_DMEM), MemorySize::RSP_DMEM);
+}
+
+void beginTask() {
+    currentTask.state.clear();
+    currentTask.pages.clear();
+    currentTask.outputs.clear();
+    currentTask.dmem.clear();
+
+    capturedPages.clear();
+
+    isTaskRunning = true;
+}
+
+template<typename T>
+void writePOD(const T &data) {
+    std::fwrite(&data, sizeof(T), 1, captureFile);
+}
+
+void writeTask(const Task &task) {
+    writePOD(TASK_MAGIC);
+
+    writePOD((u64)task.state.size());
+    std::fwrite(task.state.data(), 1, task.state.size(), captureFile);
+
+    writePOD((u64)task.pages.size());
+    for (const Page &page : task.pages) {
+        writePOD(page.addr);
+        std::fwrite(page.data.data(), 1, sys::memory::PAGE_SIZE, captureFile);
+    }
+
+    writePOD((u64)task.outputs.size());
+    for (const Output &output : task.outputs) {
+        writePOD(output.type);
+        writePOD(output.addr);
+        writePOD(output.size);
+        writePOD(output.hash);
+    }
+
+    std::fwrite(task.dmem.data(), 1, MemorySize::RSP_DMEM, captureFile);
+}
+
+void startTask() {
+    if (captureFile == NULL) {
+        return;
+    }
+
+    beginTask();
+
+    sys::savestate::State state(currentTask.state, sys::savestate::StateFlag::None);
+    doTaskState(state);
+}
+
+void finishTask() {
+    if (!isTaskRunning) {
+        return;
+    }
+
+    isTaskRunning = false;
+
+    const u8 *dmem = sys::memory::getPointer(MemoryBase::RSP_DMEM);
+    currentTask.dmem.assign(dmem, dmem + MemorySize::RSP_DMEM);
+
+    if (!isReplay) {
+        writeTask(currentTask);
+    }
+}
+
+// Stores every RDRAM page in [addr, addr + size) the task hasn't accessed yet
+void capturePages(const u64 addr, const u64 size) {
+    const u64 endAddr = std::min(addr + size, (u64)MemorySize::RDRAM);
+
+    if (addr >= endAddr) {
+        return;
+    }
+
+    for (u64 page = sys::memory::addressToPage(addr); page <= sys::memory::addressToPage(endAddr - 1); page++) {
+        if (!capturedPages.insert(page).second) {
+            continue;
+        }
+
+        const u64 pageAddr = sys::memory::pageToAddress(page);
+
+        sys::memory::materialize(pageAddr, sys::memory::PAGE_SIZE);
+
+        const u8 *mem = sys::memory::getPointer(pageAddr);
+
+        currentTask.pages.push_back(Page{pageAddr, std::vector<u8>(mem, mem + sys::memory::PAGE_SIZE)});
+    }
+}
+
+// FNV-1a over size bytes of RDRAM
+u64 hashRDRAM(u64 hash, const u64 addr, const u64 size) {
+    const u64 endAddr = std::min(addr + size, (u64)MemorySize::RDRAM);
+
+    if (addr >= endAddr) {
+        return hash;
+    }
+
+    sys::memory::materialize(addr, endAddr - addr);
+
+    const u8 *mem = sys::memory::getPointer(addr);
+
+    for (u64 i = 0; i < (endAddr - addr); i++) {
+        hash = (hash ^ mem[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// Calls func(RDRAM address, size) for every row of a transfer
+template<typename Func>
+void forEachRow(const sys::dma::Transfer &transfer, Func func) {
+    for (u64 row = 0; row < transfer.count; row++) {
+        func(transfer.dramaddr + row * (transfer.length + transfer.skip), transfer.length);
+    }
+}
+
+void beforeDMA(const sys::dma::Transfer &transfer) {
+    // Replayed tasks already have all their pages
+    if (!isTaskRunning || isReplay) {
+        return;
+    }
+
+    forEachRow(transfer, capturePages);
+}
+
+void afterDMAToRAM(const sys::dma::Transfer &transfer) {
+    if (!isTaskRunning) {
+        return;
+    }
+
+    u64 hash = FNV_OFFSET_BASIS;
+
+    forEachRow(transfer, [&hash](const u64 addr, const u64 size) {
+        hash = hashRDRAM(hash, addr, size);
+    });
+
+    currentTask.outputs.push_back(Output{OutputType::DMAToRAM, transfer.dramaddr, transfer.count * transfer.length, hash});
+}
+
+void onDPCommands(const u64 startAddr, const u64 endAddr) {
+    if (!isTaskRunning || (startAddr >= endAddr)) {
+        return;
+    }
+
+    if (!isReplay) {
+        capturePages(startAddr, endAddr - startAddr);
+    }
+
+    const u64 hash = hashRDRAM(FNV_OFFSET_BASIS, startAddr, endAddr - startAddr);
+
+    currentTask.outputs.push_back(Output{OutputType::DPCommands, startAddr, endAddr - startAddr, hash});
+}
+
+template<typename T>
+bool readPOD(FILE *file, T &data) {
+    return std::fread(&data, sizeof(T), 1, file) == 1;
+}
+
+bool readBytes(FILE *file, std::vector<u8> &data, const u64 size) {
+    data.resize(size);
+
+    return std::fread(data.data(), 1, size, file) == size;
+}
+
+bool readHeader(FILE *file) {
+    u32 magic, version;
+    if (!readPOD(file, magic) || !readPOD(file, version)) {
+        return false;
+    }
+
+    return (magic == MAGIC) && (version == VERSION);
+}
+
+bool readTask(FILE *file, Task &task) {
+    u32 magic;
+    if (!readPOD(file, magic) || (magic != TASK_MAGIC)) {
+        return false;
+    }
+
+    u64 size;
+    if (!readPOD(file, size) || (size > MAX_STATE_SIZE) || !readBytes(file, task.state, size)) {
+        return false;
+    }
+
+    u64 pageNum;
+    if (!readPOD(file, pageNum) || (pageNum > sys::memory::NUM_RDRAM_PAGES)) {
+        return false;
+    }
+
+    task.pages.resize(pageNum);
+    for (Page &page : task.pages) {
+        if (!readPOD(file, page.addr) || (page.addr >= MemorySize::RDRAM) || ((page.addr & sys::memory::PAGE_MASK) != 0)) {
+            return false;
+        }
+
+        if (!readBytes(file, page.data, sys::memory::PAGE_SIZE)) {
+            return false;
+        }
+    }
+
+    u64 outputNum;
+    if (!readPOD(file, outputNum) || (outputNum > MAX_OUTPUTS)) {
+        return false;
+    }
+
+    task.outputs.resize(outputNum);
+    for (Output &output : task.outputs) {
+        if (!readPOD(file, output.type) || !readPOD(file, output.addr) || !readPOD(file, output.size) || !readPOD(file, output.hash)) {
+            return false;
+        }
+    }
+
+    return readBytes(file, task.dmem, MemorySize::RSP_DMEM);
+}
+
+bool startReplay(const Task &task) {
+    isReplay = true;
+
+    // Drop events the previous task left behind, they'd fire in the middle of this one
+    sys::scheduler::reset();
+
+    for (const Page &page : task.pages) {
+        sys::memory::materialize(page.addr, sys::memory::PAGE_SIZE);
+
+        std::copy(page.data.begin(), page.data.end(), sys::memory::getPointer(page.addr));
+
+        sys::memory::markDirty(page.addr, sys::memory::PAGE_SIZE);
+    }
+
+    sys::savestate::State state(task.state.data(), task.state.size(), sys::savestate::StateFlag::None);
+    doTaskState(state);
+
+    if (!state.isValid()) {
+        return false;
+    }
+
+    // Scheduler events aren't part of the capture, finish DMAs that were still in flight
+    while (sp::isDMABusy()) {
+        sp::finishDMA();
+    }
+
+    beginTask();
+
+    return true;
+}
+
+const Task &getReplayResult() {
+    return currentTask;
+}
+
+}
@@ -0,0 +1,156 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "hw/rsp/disassembler.hpp"
+
+#include <cstdio>
+
+#include "hw/cpu/disassembler.hpp"
+
+namespace hw::rsp::disassembler {
+
+constexpr u32 IMEM_MASK = 0xFFF;
+
+// SP and DP registers as seen through COP0
+constexpr const char *COP0_NAMES[16] = {
+    "SP_MEM_ADDR", "SP_DRAM_ADDR", "SP_RD_LEN", "SP_WR_LEN",
+    "SP_STATUS", "SP_DMA_FULL", "SP_DMA_BUSY", "SP_SEMAPHORE",
+    "DP_START", "DP_END", "DP_CURRENT", "DP_STATUS",
+    "DP_CLOCK", "DP_BUSY", "DP_PIPE_BUSY", "DP_TMEM_BUSY",
+};
+
+constexpr const char *VU_COMPUTE_NAMES[64] = {
+    "vmulf", "vmulu", "vrndp", "vmulq", "vmudl", "vmudm", "vmudn", "vmudh",
+    "vmacf", "vmacu", "vrndn", "vmacq", "vmadl", "vmadm", "vmadn", "vmadh",
+    "vadd", "vsub", NULL, "vabs", "vaddc", "vsubc", NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, "vsar", NULL, NULL,
+    "vlt", "veq", "vne", "vge", "vcl", "vch", "vcr", "vmrg",
+    "vand", "vnand", "vor", "vnor", "vxor", "vnxor", NULL, NULL,
+    "vrcp", "vrcpl", "vrcph", "vmov", "vrsq", "vrsql", "vrsqh", "vnop",
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+};
+
+// Vector loads/stores, and the size their offset is scaled by
+struct VULoadStore {
+    const char *name;
+    u32 scale;
+};
+
+constexpr VULoadStore VU_LOAD_NAMES[12] = {
+    {"lbv", 1}, {"lsv", 2}, {"llv", 4}, {"ldv", 8}, {"lqv", 16}, {"lrv", 16},
+    {"lpv", 8}, {"luv", 8}, {"lhv", 16}, {"lfv", 16}, {"lwv", 16}, {"ltv", 16},
+};
+
+constexpr VULoadStore VU_STORE_NAMES[12] = {
+    {"sbv", 1}, {"ssv", 2}, {"slv", 4}, {"sdv", 8}, {"sqv", 16}, {"srv", 16},
+    {"spv", 8}, {"suv", 8}, {"shv", 16}, {"sfv", 16}, {"swv", 16}, {"stv", 16},
+};
+
+std::string format(const char *fmt, auto... args) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), fmt, args...);
+
+    return buffer;
+}
+
+std::string disassembleLoadStore(const VULoadStore (&names)[12], const u32 instr) {
+    const u32 opcode = (instr >> 11) & 31;
+
+    if (opcode >= 12) {
+        return format(".word 0x%08X", instr);
+    }
+
+    const u32 base = (instr >> 21) & 31;
+    const u32 vt = (instr >> 16) & 31;
+    const u32 element = (instr >> 7) & 15;
+
+    // 7-bit signed offset
+    const i32 offset = ((i32)(instr << 25) >> 25) * (i32)names[opcode].scale;
+
+    return format("%s v%u[%u], %d(%s)", names[opcode].name, vt, element, offset, cpu::disassembler::getRegisterName(base));
+}
+
+std::string disassembleVectorUnit(const u32 instr) {
+    const u32 rs = (instr >> 21) & 31;
+    const u32 rt = (instr >> 16) & 31;
+    const u32 rd = (instr >> 11) & 31;
+    const u32 element = (instr >> 7) & 15;
+
+    const char *rtName = cpu::disassembler::getRegisterName(rt);
+
+    switch (rs) {
+        case 0x00:
+            return format("mfc2 %s, v%u[%u]", rtName, rd, element);
+        case 0x02:
+            return format("cfc2 %s, vc%u", rtName, rd & 3);
+        case 0x04:
+            return format("mtc2 %s, v%u[%u]", rtName, rd, element);
+        case 0x06:
+            return format("ctc2 %s, vc%u", rtName, rd & 3);
+        default:
+            break;
+    }
+
+    const char *name = VU_COMPUTE_NAMES[instr & 63];
+
+    if ((rs < 0x10) || (name == NULL)) {
+        return format(".word 0x%08X", instr);
+    }
+
+    const u32 vt = rt;
+    const u32 vs = rd;
+    const u32 vd = (instr >> 6) & 31;
+    const u32 broadcast = rs & 15;
+
+    return format("%s v%u, v%u, v%u[%u]", name, vd, vs, vt, broadcast);
+}
+
+std::string disassemble(const u32 pc, const u32 instr) {
+    const u32 op = instr >> 26;
+
+    switch (op) {
+        case 0x02:
+        case 0x03:
+            return format("%s 0x%03X", (op == 0x02) ? "j" : "jal", (instr << 2) & IMEM_MASK);
+        case 0x10:
+            {
+                const u32 rs = (instr >> 21) & 31;
+                const u32 rt = (instr >> 16) & 31;
+                const u32 rd = (instr >> 11) & 15;
+
+                if ((rs != 0x00) && (rs != 0x04)) {
+                    break;
+                }
+
+                return format("%s %s, %s", (rs == 0x00) ? "mfc0" : "mtc0", cpu::disassembler::getRegisterName(rt), COP0_NAMES[rd]);
+            }
+        case 0x12:
+            return disassembleVectorUnit(instr);
+        case 0x32:
+            return disassembleLoadStore(VU_LOAD_NAMES, instr);
+        case 0x3A:
+            return disassembleLoadStore(VU_STORE_NAMES, instr);
+        default:
+            break;
+    }
+
+    return cpu::disassembler::disassemble(pc, instr);
+}
+
+int getDestinationRegister(const u32 instr) {
+    const u32 op = instr >> 26;
+    const u32 rs = (instr >> 21) & 31;
+
+    // MFC2/CFC2
+    if (op == 0x12) {
+        const int rt = (instr >> 16) & 31;
+
+        return (((rs == 0x00) || (rs == 0x02)) && (rt != 0)) ? rt : -1;
+    }
+
+    return cpu::disassembler::getDestinationRegister(instr);
+}
+
+}
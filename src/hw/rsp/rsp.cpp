@@ -14,8 +14,11 @@
 #include "hw/dp.hpp"
 #include "hw/sp.hpp"
 #include "hw/cpu/cpu.hpp"
+#include "hw/rsp/disassembler.hpp"
 
 #include "sys/memory.hpp"
+#include "sys/stats.hpp"
+#include "sys/trace.hpp"
 
 namespace hw::rsp {
 
@@ -329,6 +332,11 @@ void reset() {
     isHalted = true;
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regFile);
+    state.doPOD(isHalted);
+}
+
 bool isValidRegisterIndex(const u32 idx) {
     return idx < Register::NumberOfRegisters;
 }
@@ -1040,10 +1048,7 @@ void VXOR(const VUInstruction instr) {
     }
 }
 
-void doInstruction() {
-    Instruction instr;
-    instr.raw = fetch();
-
+void execute(const Instruction instr) {
     const u32 op = instr.iType.op;
     switch (op) {
         case Opcode::SPECIAL:
@@ -1218,16 +1223,47 @@ void doInstruction() {
     }
 }
 
-void run(const i64 cycles) {
+void doInstruction() {
+    Instruction instr;
+    instr.raw = fetch();
+
+    execute(instr);
+}
+
+// Runs one instruction and records it along with the GPR it wrote
+void doTracedInstruction() {
+    Instruction instr;
+    instr.raw = fetch();
+
+    execute(instr);
+
+    const int dest = disassembler::getDestinationRegister(instr.raw);
+
+    sys::trace::record(sys::trace::Core::RSP, getCurrentPC(), instr.raw, (dest >= 0) ? get(dest) : 0);
+}
+
+i64 run(const i64 cycles) {
+    const bool isTracing = sys::trace::isActive(sys::trace::Core::RSP);
+
     for (i64 i = 0; i < cycles; i++) {
         if (sp::isHalted()) {
-            return;
+            sys::stats::counters.rspInstructions += i;
+
+            return i;
         }
 
         regFile.cpc.addr = getPC();
 
-        doInstruction();
+        if (isTracing) [[unlikely]] {
+            doTracedInstruction();
+        } else {
+            doInstruction();
+        }
     }
+
+    sys::stats::counters.rspInstructions += cycles;
+
+    return cycles;
 }
 
 }
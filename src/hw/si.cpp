@@ -14,7 +14,10 @@
 #include "hw/mi.hpp"
 #include "hw/pif/pif.hpp"
 
+#include "sys/dma.hpp"
 #include "sys/memory.hpp"
+#include "sys/scheduler.hpp"
+#include "sys/stats.hpp"
 
 namespace hw::si {
 
@@ -62,9 +65,16 @@ struct Registers {
     STATUS status;
 };
 
+// Approximate duration of a 64-byte PIF RAM DMA
+constexpr i64 DMA_CYCLES = 4608;
+
 Registers regs;
 
-void init() {}
+u64 idFinishDMA;
+
+void init() {
+    idFinishDMA = sys::scheduler::registerEvent("SI DMA", [](int) { finishDMA(); });
+}
 
 void deinit() {}
 
@@ -72,6 +82,10 @@ void reset() {
     std::memset(&regs, 0, sizeof(Registers));
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+}
+
 void startDMAFromPIF() {
     if (regs.status.dmaBusy != 0) {
         PLOG_ERROR << "SI DMA is still active";
@@ -86,6 +100,15 @@ void startDMAFromPIF() {
 
     regs.status.dmaBusy = 1;
 
+    if (pif::isHLE()) {
+        // PIF RAM already holds the command results
+        transferFromPIF();
+
+        sys::scheduler::addEvent(idFinishDMA, 0, DMA_CYCLES);
+
+        return;
+    }
+
     pif::setInterruptAPending();
     pif::setRCPPort(true, true);
 }
@@ -98,58 +121,98 @@ void startDMAToPIF() {
     }
 
     const u64 dramaddr = regs.dramaddr.addr;
-    const u64 pifaddr = ((u64)regs.adrd64b.addr) << 2;
+    const u64 pifaddr = ((u64)regs.adwr64b.addr) << 2;
 
     PLOG_VERBOSE << "DMA to PIF requested (DRAM address = " << std::hex << dramaddr << ", PIF RAM address = " << pifaddr << ")";
 
     regs.status.dmaBusy = 1;
 
+    if (pif::isHLE()) {
+        // Writing the command byte makes PIF-NUS execute the command block right away
+        transferToPIF();
+
+        sys::scheduler::addEvent(idFinishDMA, 0, DMA_CYCLES);
+
+        return;
+    }
+
     pif::setInterruptAPending();
     pif::setRCPPort(false, true);
 }
 
-void doDMAFromPIF() {
-    if (regs.status.dmaBusy == 0) {
-        return;
-    }
+sys::dma::Transfer makeTransfer(const u64 dramaddr, const u64 pifaddr) {
+    sys::dma::Transfer transfer;
+    transfer.dramaddr = dramaddr;
+    transfer.local = pif::getRAM();
+    transfer.localAddr = (pifaddr - sys::memory::MemoryBase::PIF_RAM) & (sys::memory::MemorySize::PIF_RAM - 1);
+    transfer.localSize = sys::memory::MemorySize::PIF_RAM;
+    transfer.length = sys::memory::MemorySize::PIF_RAM;
+    transfer.count = 1;
+    transfer.skip = 0;
+    transfer.isLocalWrapping = true;
+
+    return transfer;
+}
 
+void transferFromPIF() {
     const u64 dramaddr = regs.dramaddr.addr;
     const u64 pifaddr = ((u64)regs.adrd64b.addr) << 2;
 
     PLOG_VERBOSE << "DMA from PIF (DRAM address = " << std::hex << dramaddr << ", PIF RAM address = " << pifaddr << ")";
 
-    for (u64 i = 0; i < 64; i += 4) {
-        sys::memory::write(dramaddr + i, byteswap(pif::read<u32>(pifaddr + i)));
+    sys::dma::copyToRDRAM(makeTransfer(dramaddr, pifaddr));
+
+    sys::stats::countDMA(sys::stats::DMAEngine::SI, 64);
+
+    regs.dramaddr.addr += 64;
+}
+
+void transferToPIF() {
+    const u64 dramaddr = regs.dramaddr.addr;
+    const u64 pifaddr = ((u64)regs.adwr64b.addr) << 2;
+
+    PLOG_VERBOSE << "DMA to PIF (DRAM address = " << std::hex << dramaddr << ", PIF RAM address = " << pifaddr << ")";
+
+    sys::dma::copyFromRDRAM(makeTransfer(dramaddr, pifaddr));
+
+    sys::stats::countDMA(sys::stats::DMAEngine::SI, 64);
+
+    // PIF-NUS would pick up the new command on its own
+    if (pif::isHLE()) {
+        pif::processCommands();
     }
 
-    regs.status.dmaBusy = 0;
     regs.dramaddr.addr += 64;
+}
 
-    pif::setInterruptAPending();
+void finishDMA() {
+    regs.status.dmaBusy = 0;
 
     mi::requestInterrupt(mi::InterruptSource::SI);
 }
 
-void doDMAToPIF() {
+void doDMAFromPIF() {
     if (regs.status.dmaBusy == 0) {
         return;
     }
 
-    const u64 dramaddr = regs.dramaddr.addr;
-    const u64 pifaddr = ((u64)regs.adwr64b.addr) << 2;
+    transferFromPIF();
 
-    PLOG_VERBOSE << "DMA to PIF (DRAM address = " << std::hex << dramaddr << ", PIF RAM address = " << pifaddr << ")";
+    pif::setInterruptAPending();
+
+    finishDMA();
+}
 
-    for (u64 i = 0; i < 64; i += 4) {
-        pif::write(pifaddr + i, byteswap(sys::memory::read<u32>(dramaddr + i)));
+void doDMAToPIF() {
+    if (regs.status.dmaBusy == 0) {
+        return;
     }
 
-    regs.status.dmaBusy = 0;
-    regs.dramaddr.addr += 64;
+    transferToPIF();
 
     pif::setInterruptAPending();
 
-    mi::requestInterrupt(mi::InterruptSource::SI);
+    finishDMA();
 }
 
 u32 readIO(const u64 ioaddr) {
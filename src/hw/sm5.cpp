@@ -104,6 +104,15 @@ void SM5::reset() {
     isOnStandby = false;
 }
 
+void SM5::doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+    state.doPOD(isOnStandby);
+}
+
+bool SM5::isInStandby() const {
+    return isOnStandby;
+}
+
 void SM5::checkInterruptPending() {
     PLOG_INFO << "IME = " << regs.ime << ", IE = " << std::hex << (u16)regs.ie.raw << ", IF = " << (u16)regs.ifl.raw;
 
@@ -12,9 +12,13 @@
 #include <plog/Log.h>
 
 #include "hw/mi.hpp"
+#include "hw/rsp/capture.hpp"
 #include "hw/rsp/rsp.hpp"
 
+#include "sys/dma.hpp"
 #include "sys/memory.hpp"
+#include "sys/scheduler.hpp"
+#include "sys/stats.hpp"
 
 namespace hw::sp {
 
@@ -85,7 +89,14 @@ struct Registers {
 
 Registers regs;
 
-void init() {}
+// Number of DMAs that haven't signalled completion yet
+u32 pendingDMAs;
+
+u64 idFinishDMA;
+
+void init() {
+    idFinishDMA = sys::scheduler::registerEvent("SP DMA", [](int) { finishDMA(); });
+}
 
 void deinit() {}
 
@@ -93,6 +104,13 @@ void reset() {
     std::memset(&regs, 0, sizeof(Registers));
 
     regs.status.halted = 1;
+
+    pendingDMAs = 0;
+}
+
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+    state.doPOD(pendingDMAs);
 }
 
 void BREAK() {
@@ -104,92 +122,98 @@ void BREAK() {
     if (status.interruptOnBreak) {
         mi::requestInterrupt(mi::InterruptSource::SP);
     }
+
+    rsp::capture::finishTask();
 }
 
 bool isHalted() {
     return regs.status.halted != 0;
 }
 
-void doDMAToRAM() {
-    const u64 dramaddr = regs.ramaddr.addr << 3;
-    u64 rspAddr = regs.spaddr.addr;
+bool isDMABusy() {
+    return regs.status.dmaBusy != 0;
+}
+
+// Approximates how long an RSP DMA takes, in CPU cycles
+i64 getDMACycles(const sys::dma::Transfer &transfer) {
+    // Roughly 8 bytes per RCP cycle, plus some setup per row
+    const u64 rcpCycles = (transfer.length * transfer.count) / 8 + 8 * transfer.count;
 
-    const u64 length = regs.wrlen.rdlen + 1;
-    const u64 count = regs.wrlen.count + 1;
-    const u64 skip = regs.wrlen.skip;
+    // The RCP runs at 2/3 of the CPU clock
+    return (3 * rcpCycles) / 2;
+}
 
-    // Casting this to u64 * is fine because the address is guaranteed
-    // to be 64-bit aligned
-    u64 *dram = (u64 *)sys::memory::getPointer(dramaddr);
+sys::dma::Transfer makeTransfer(const LEN &len) {
+    sys::dma::Transfer transfer;
+    transfer.dramaddr = regs.ramaddr.addr << 3;
+    transfer.localAddr = regs.spaddr.addr << 3;
+    transfer.localSize = sys::memory::MemorySize::RSP_DMEM;
+    transfer.length = 8 * (len.rdlen + 1);
+    transfer.count = len.count + 1;
+    transfer.skip = 8 * len.skip;
+    transfer.isLocalWrapping = true;
 
-    u64 *spmem;
     if (regs.spaddr.isIMEM) {
-        PLOG_VERBOSE << "DMA from RSP IMEM (RSP address = " << std::hex << rspAddr << ", DRAM address = " << dramaddr << ", length = " << std::dec << length << ", count = " << count << ", skip = " << skip << ")";
-
-        spmem = (u64 *)sys::memory::getPointer(sys::memory::MemoryBase::RSP_IMEM);
+        transfer.local = sys::memory::getPointer(sys::memory::MemoryBase::RSP_IMEM);
     } else {
-        PLOG_VERBOSE << "DMA from RSP DMEM (RSP address = " << std::hex << rspAddr << ", DRAM address = " << dramaddr << ", length = " << std::dec << length << ", count = " << count << ", skip = " << skip << ")";
-
-        spmem = (u64 *)sys::memory::getPointer(sys::memory::MemoryBase::RSP_DMEM);
+        transfer.local = sys::memory::getPointer(sys::memory::MemoryBase::RSP_DMEM);
     }
 
-    for (u64 c = 0; c < count; c++) {
-        for (u64 i = 0; i < length; i++) {
-            *dram++ = spmem[rspAddr++];
+    return transfer;
+}
+
+// Writes final register values, schedules completion
+void endDMA(const sys::dma::Transfer &transfer, LEN &len) {
+    sys::stats::countDMA(sys::stats::DMAEngine::SP, transfer.length * transfer.count);
 
-            rspAddr &= 0x1FF;
-        }
+    regs.ramaddr.addr = sys::dma::getEndAddress(transfer) >> 3;
+    regs.spaddr.addr = ((transfer.localAddr + transfer.length * transfer.count) & (transfer.localSize - 1)) >> 3;
 
-        dram += skip;
-    }
+    len.rdlen = 0xFF8 >> 3;
+    len.count = 0;
 
-    // Write final register values
-    regs.ramaddr.addr = (dramaddr >> 3) + (count - 1) * (length + skip) + length;
-    regs.spaddr.addr = rspAddr;
+    // The copy already happened, but DMA_BUSY/DMA_FULL stay set for as long as the transfer would take
+    pendingDMAs++;
 
-    regs.wrlen.rdlen = 0xFF8 >> 3;
-    regs.wrlen.count = 0;
+    regs.status.dmaBusy = 1;
+    regs.status.dmaFull = (pendingDMAs > 1) ? 1 : 0;
+
+    sys::scheduler::addEvent(idFinishDMA, 0, getDMACycles(transfer));
 }
 
-void doDMAToRSP() {
-    const u64 dramaddr = regs.ramaddr.addr << 3;
-    u64 rspAddr = regs.spaddr.addr;
+void doDMAToRAM() {
+    const sys::dma::Transfer transfer = makeTransfer(regs.wrlen);
 
-    const u64 length = regs.rdlen.rdlen + 1;
-    const u64 count = regs.rdlen.count + 1;
-    const u64 skip = regs.rdlen.skip;
+    PLOG_VERBOSE << "DMA from RSP " << (regs.spaddr.isIMEM ? "IMEM" : "DMEM") << " (RSP address = " << std::hex << transfer.localAddr << ", DRAM address = " << transfer.dramaddr << ", length = " << std::dec << transfer.length << ", count = " << transfer.count << ", skip = " << transfer.skip << ")";
 
-    // Casting this to u64 * is fine because the address is guaranteed
-    // to be 64-bit aligned
-    u64 *dram = (u64 *)sys::memory::getPointer(dramaddr);
+    rsp::capture::beforeDMA(transfer);
 
-    u64 *spmem;
-    if (regs.spaddr.isIMEM) {
-        PLOG_VERBOSE << "DMA to RSP IMEM (RSP address = " << std::hex << rspAddr << ", DRAM address = " << dramaddr << ", length = " << std::dec << length << ", count = " << count << ", skip = " << skip << ")";
+    sys::dma::copyToRDRAM(transfer);
 
-        spmem = (u64 *)sys::memory::getPointer(sys::memory::MemoryBase::RSP_IMEM);
-    } else {
-        PLOG_VERBOSE << "DMA to RSP DMEM (RSP address = " << std::hex << rspAddr << ", DRAM address = " << dramaddr << ", length = " << std::dec << length << ", count = " << count << ", skip = " << skip << ")";
+    rsp::capture::afterDMAToRAM(transfer);
 
-        spmem = (u64 *)sys::memory::getPointer(sys::memory::MemoryBase::RSP_DMEM);
-    }
+    endDMA(transfer, regs.wrlen);
+}
+
+void doDMAToRSP() {
+    const sys::dma::Transfer transfer = makeTransfer(regs.rdlen);
 
-    for (u64 c = 0; c < count; c++) {
-        for (u64 i = 0; i < length; i++) {
-            spmem[rspAddr++] = *dram++;
+    PLOG_VERBOSE << "DMA to RSP " << (regs.spaddr.isIMEM ? "IMEM" : "DMEM") << " (RSP address = " << std::hex << transfer.localAddr << ", DRAM address = " << transfer.dramaddr << ", length = " << std::dec << transfer.length << ", count = " << transfer.count << ", skip = " << transfer.skip << ")";
 
-            rspAddr &= 0x1FF;
-        }
+    rsp::capture::beforeDMA(transfer);
 
-        dram += skip;
-    }
+    sys::dma::copyFromRDRAM(transfer);
+
+    endDMA(transfer, regs.rdlen);
+}
 
-    // Write final register values
-    regs.ramaddr.addr = (dramaddr >> 3) + (count - 1) * (length + skip) + length;
-    regs.spaddr.addr = rspAddr;
+void finishDMA() {
+    if (pendingDMAs > 0) {
+        pendingDMAs--;
+    }
 
-    regs.rdlen.rdlen = 0xFF8 >> 3;
-    regs.rdlen.count = 0;
+    regs.status.dmaBusy = (pendingDMAs > 0) ? 1 : 0;
+    regs.status.dmaFull = (pendingDMAs > 1) ? 1 : 0;
 }
 
 u32 readIO(const u64 ioaddr) {
@@ -244,6 +268,8 @@ u32 readIO(const u64 ioaddr) {
 }
 
 void writeIO(const u64 ioaddr, const u32 data) {
+    const bool wasHalted = isHalted();
+
     switch (ioaddr) {
         case IORegister::SPADDR:
             PLOG_INFO << "SPADDR write (data = " << std::hex << data << ")";
@@ -380,6 +406,13 @@ void writeIO(const u64 ioaddr, const u32 data) {
 
             exit(0);
     }
+
+    // A task runs from the RSP being unhalted until it halts again
+    if (wasHalted && !isHalted()) {
+        rsp::capture::startTask();
+    } else if (!wasHalted && isHalted()) {
+        rsp::capture::finishTask();
+    }
 }
 
 }
@@ -183,8 +183,8 @@ Registers regs;
 u64 idDoHBLANK, idDoVBLANK;
 
 void init() {
-    idDoHBLANK = sys::scheduler::registerEvent([](int) { doHBLANK(); });
-    idDoVBLANK = sys::scheduler::registerEvent([](int) { doVBLANK(); });
+    idDoHBLANK = sys::scheduler::registerEvent("VI HBLANK", [](int) { doHBLANK(); });
+    idDoVBLANK = sys::scheduler::registerEvent("VI VBLANK", [](int) { doVBLANK(); });
 }
 
 void deinit() {}
@@ -196,6 +196,14 @@ void reset() {
     sys::scheduler::addEvent(idDoVBLANK, 0, CYCLES_PER_FRAME);
 }
 
+void doSavestate(sys::savestate::State &state) {
+    state.doPOD(regs);
+
+    if (state.isLoading() && (regs.width.width != 0)) {
+        renderer::changeResolution(regs.width.width);
+    }
+}
+
 u32 readIO(const u64 ioaddr) {
     switch (ioaddr) {
         case IORegister::CURRENT:
@@ -3,25 +3,245 @@
  * Copyright (C) 2024  noumidev
  */
 
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 #include <plog/Init.h>
 #include <plog/Log.h>
 #include <plog/Formatters/FuncMessageFormatter.h>
 #include <plog/Appenders/ColorConsoleAppender.h>
 
+#include "hw/cart.hpp"
+#include "hw/pi.hpp"
+#include "hw/cpu/hle.hpp"
+#include "hw/cpu/lockstep.hpp"
+#include "hw/pif/joybus.hpp"
+#include "hw/pif/pak.hpp"
+#include "hw/rsp/capture.hpp"
+
+#include "renderer/overlay.hpp"
+
 #include "sys/emulator.hpp"
+#include "sys/movie.hpp"
+#include "sys/perf.hpp"
+#include "sys/trace.hpp"
+#include "sys/watchpoint.hpp"
+
+constexpr int MAX_RUN_AHEAD_FRAMES = 4;
+
+void printUsage() {
+    PLOG_ERROR << "Usage: Satou64 [options] [path to boot ROM] [path to PIF-NUS ROM] [path to N64 ROM]";
+    PLOG_ERROR << "       Satou64 [options] [path to PIF-NUS ROM] [path to N64 ROM]";
+    PLOG_ERROR << "       Satou64 [options] [path to N64 ROM]";
+    PLOG_ERROR << "Options:";
+    PLOG_ERROR << "  --fast-boot      Skip the boot ROM and IPL3";
+    PLOG_ERROR << "  --hle-pif        High-level emulate PIF-NUS";
+    PLOG_ERROR << "  --hle-libultra   Replace common libultra routines with native code";
+    PLOG_ERROR << "  --lockstep       Check every --hle-libultra call against the interpreter";
+    PLOG_ERROR << "  --lazy-dma       Copy large cartridge DMAs on first access";
+    PLOG_ERROR << "  --run-ahead N    Emulate N frames ahead to hide input lag (0-" << MAX_RUN_AHEAD_FRAMES << ")";
+    PLOG_ERROR << "  --rewind         Keep a rewind history, hold Backspace to rewind";
+    PLOG_ERROR << "  --record PATH    Record controller input to a movie file";
+    PLOG_ERROR << "  --play PATH      Play back controller input from a movie file";
+    PLOG_ERROR << "  --save-type T    Override the cartridge save type (none, eeprom4k, eeprom16k, sram, flash)";
+    PLOG_ERROR << "  --controllers N  Number of connected controllers (1-" << (int)hw::pif::joybus::MAX_CONTROLLERS << ")";
+    PLOG_ERROR << "  --pak TYPE       Accessory plugged into every controller (none, controller, rumble)";
+    PLOG_ERROR << "  --watch SPEC     Report accesses to a memory range (rwx:address[:size], e.g. w:80001000:8)";
+    PLOG_ERROR << "  --watch-dump     Print the CPU state on every watchpoint hit";
+    PLOG_ERROR << "  --rsp-capture P  Capture every RSP task to P, for satou64_rsp_replay";
+    PLOG_ERROR << "  --trace PATH     Record executed instructions to PATH, for satou64_tracedump (F9 pauses)";
+    PLOG_ERROR << "  --trace-core C   Cores to trace (cpu, rsp, all)";
+    PLOG_ERROR << "  --trace-pc S:E   Only trace instructions between PCs S and E (hex)";
+    PLOG_ERROR << "  --trace-frame N  Start tracing at frame N";
+    PLOG_ERROR << "  --perf           Report host CPU counters per subsystem on exit (Linux)";
+    PLOG_ERROR << "  --overlay        Show the performance overlay (F10 toggles)";
+}
 
 int main(int argc, char **argv) {
     // Initialize logger
     static plog::ColorConsoleAppender<plog::FuncMessageFormatter> consoleAppender;
     plog::init(plog::fatal, &consoleAppender);
 
-    if (argc < 4) {
-        PLOG_ERROR << "Usage: Satou64 [path to boot ROM] [path to PIF-NUS ROM] [path to N64 ROM]";
+    bool isFastBoot = false;
+    bool isPIFHLE = false;
+
+    bool isLazyDMA = false;
+    bool isOverlayEnabled = false;
+
+    int runAheadFrames = 0;
+
+    bool isRewindEnabled = false;
+
+    const char *recordPath = NULL;
+    const char *playPath = NULL;
+
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--fast-boot") == 0) {
+            isFastBoot = true;
+        } else if (std::strcmp(argv[i], "--hle-pif") == 0) {
+            isPIFHLE = true;
+        } else if (std::strcmp(argv[i], "--hle-libultra") == 0) {
+            hw::cpu::hle::setEnabled(true);
+        } else if (std::strcmp(argv[i], "--lockstep") == 0) {
+            hw::cpu::hle::setEnabled(true);
+            hw::cpu::lockstep::setEnabled(true);
+        } else if (std::strcmp(argv[i], "--lazy-dma") == 0) {
+            isLazyDMA = true;
+        } else if ((std::strcmp(argv[i], "--run-ahead") == 0) && ((i + 1) < argc)) {
+            char *end;
+            runAheadFrames = std::strtol(argv[++i], &end, 10);
+
+            if ((*end != '\0') || (runAheadFrames < 0) || (runAheadFrames > MAX_RUN_AHEAD_FRAMES)) {
+                printUsage();
+
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--rewind") == 0) {
+            isRewindEnabled = true;
+        } else if ((std::strcmp(argv[i], "--record") == 0) && ((i + 1) < argc)) {
+            recordPath = argv[++i];
+        } else if ((std::strcmp(argv[i], "--play") == 0) && ((i + 1) < argc)) {
+            playPath = argv[++i];
+        } else if ((std::strcmp(argv[i], "--save-type") == 0) && ((i + 1) < argc)) {
+            hw::cart::SaveType saveType;
+            if (!hw::cart::parseSaveType(argv[++i], saveType)) {
+                printUsage();
+
+                return -1;
+            }
+
+            hw::cart::setSaveType(saveType);
+        } else if ((std::strcmp(argv[i], "--controllers") == 0) && ((i + 1) < argc)) {
+            char *end;
+            const int controllerNum = std::strtol(argv[++i], &end, 10);
+
+            if ((*end != '\0') || (controllerNum < 1) || (controllerNum > hw::pif::joybus::MAX_CONTROLLERS)) {
+                printUsage();
+
+                return -1;
+            }
+
+            hw::pif::joybus::setControllerNum(controllerNum);
+        } else if ((std::strcmp(argv[i], "--pak") == 0) && ((i + 1) < argc)) {
+            hw::pif::pak::PakType pakType;
+            if (!hw::pif::pak::parsePakType(argv[++i], pakType)) {
+                printUsage();
+
+                return -1;
+            }
+
+            hw::pif::pak::setPakType(pakType);
+        } else if ((std::strcmp(argv[i], "--watch") == 0) && ((i + 1) < argc)) {
+            u64 paddr, size;
+            u32 accessTypes;
+            if (!sys::watchpoint::parseWatchpoint(argv[++i], paddr, size, accessTypes)) {
+                printUsage();
+
+                return -1;
+            }
+
+            sys::watchpoint::add(paddr, size, accessTypes);
+        } else if (std::strcmp(argv[i], "--watch-dump") == 0) {
+            sys::watchpoint::setDumpState(true);
+        } else if ((std::strcmp(argv[i], "--rsp-capture") == 0) && ((i + 1) < argc)) {
+            hw::rsp::capture::setPath(argv[++i]);
+        } else if ((std::strcmp(argv[i], "--trace") == 0) && ((i + 1) < argc)) {
+            sys::trace::setPath(argv[++i]);
+        } else if ((std::strcmp(argv[i], "--trace-core") == 0) && ((i + 1) < argc)) {
+            u32 coreMask;
+            if (!sys::trace::parseCores(argv[++i], coreMask)) {
+                printUsage();
+
+                return -1;
+            }
+
+            sys::trace::setCores(coreMask);
+        } else if ((std::strcmp(argv[i], "--trace-pc") == 0) && ((i + 1) < argc)) {
+            u32 start, end;
+            if (!sys::trace::parsePCRange(argv[++i], start, end)) {
+                printUsage();
+
+                return -1;
+            }
+
+            sys::trace::setPCRange(start, end);
+        } else if ((std::strcmp(argv[i], "--trace-frame") == 0) && ((i + 1) < argc)) {
+            char *end;
+            const long long frame = std::strtoll(argv[++i], &end, 10);
+
+            if ((*end != '\0') || (frame < 0)) {
+                printUsage();
+
+                return -1;
+            }
+
+            sys::trace::setStartFrame(frame);
+        } else if (std::strcmp(argv[i], "--perf") == 0) {
+            sys::perf::setEnabled(true);
+        } else if (std::strcmp(argv[i], "--overlay") == 0) {
+            isOverlayEnabled = true;
+        } else if (std::strncmp(argv[i], "--", 2) == 0) {
+            printUsage();
+
+            return -1;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    const char *bootPath = NULL;
+    const char *pifPath = NULL;
+    const char *romPath = NULL;
+
+    switch (paths.size()) {
+        case 1:
+            romPath = paths[0];
+            break;
+        case 2:
+            pifPath = paths[0];
+            romPath = paths[1];
+            break;
+        case 3:
+            bootPath = paths[0];
+            pifPath = paths[1];
+            romPath = paths[2];
+            break;
+        default:
+            printUsage();
+
+            return -1;
+    }
+
+    if (isFastBoot) {
+        bootPath = NULL;
+    }
+
+    if (isPIFHLE) {
+        pifPath = NULL;
+    }
+
+    if ((recordPath != NULL) && (playPath != NULL)) {
+        printUsage();
 
         return -1;
     }
 
-    sys::emulator::init(argv[1], argv[2], argv[3]);
+    sys::emulator::init(bootPath, pifPath, romPath);
+    sys::emulator::setRunAheadFrames(runAheadFrames);
+    sys::emulator::setRewindEnabled(isRewindEnabled);
+
+    hw::pi::setLazyDMA(isLazyDMA);
+
+    renderer::overlay::setEnabled(isOverlayEnabled);
+
+    if (recordPath != NULL) {
+        sys::movie::startRecording(recordPath);
+    } else if (playPath != NULL) {
+        sys::movie::startPlayback(playPath);
+    }
+
     sys::emulator::reset();
     sys::emulator::run();
     sys::emulator::deinit();
@@ -0,0 +1,311 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "renderer/overlay.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sys/audio.hpp"
+#include "sys/perf.hpp"
+
+namespace renderer::overlay {
+
+using Clock = std::chrono::steady_clock;
+
+// VI runs at a fixed 60 Hz, see hw::vi
+constexpr double FRAMES_PER_SECOND = 60.0;
+
+// Numbers are averaged over this many seconds so they stay readable
+constexpr double REFRESH_INTERVAL = 0.5;
+
+constexpr u32 PADDING = 4;
+
+// 3x5 glyphs in 4x6 cells
+constexpr u32 GLYPH_WIDTH = 3;
+constexpr u32 GLYPH_HEIGHT = 5;
+constexpr u32 CELL_WIDTH = 4;
+constexpr u32 CELL_HEIGHT = 6;
+
+constexpr u32 GRAPH_WIDTH = WIDTH - 2 * PADDING;
+constexpr u32 GRAPH_HEIGHT = 24;
+constexpr u32 GRAPH_Y = HEIGHT - PADDING - GRAPH_HEIGHT;
+
+// Full graph height, the reference line is at one frame
+constexpr double GRAPH_SCALE = 2.0 / FRAMES_PER_SECOND;
+
+// RGBX8888. Layer pixels are never 0, which is what marks them transparent
+namespace Color {
+    enum : u32 {
+        Text = 0xFFFFFFFF,
+        Reference = 0x606060FF,
+        CPU = 0x4FA3FFFF,
+        RSP = 0xFFB347FF,
+        RDP = 0x7CFC00FF,
+        Present = 0xFF5C8AFF,
+        Other = 0x909090FF,
+    };
+}
+
+// Rows top to bottom, 3 bits each, MSB is the leftmost pixel. Indexed from ' '
+constexpr u16 FONT[] = {
+    0, // ' '
+    0b010'010'010'000'010, // !
+    0, 0, 0,
+    0b101'001'010'100'101, // %
+    0, 0, 0, 0, 0, 0, 0,
+    0b000'000'111'000'000, // -
+    0b000'000'000'000'010, // .
+    0b001'001'010'100'100, // /
+    0b111'101'101'101'111, // 0
+    0b010'110'010'010'111, // 1
+    0b111'001'111'100'111, // 2
+    0b111'001'111'001'111, // 3
+    0b101'101'111'001'001, // 4
+    0b111'100'111'001'111, // 5
+    0b111'100'111'101'111, // 6
+    0b111'001'001'001'001, // 7
+    0b111'101'111'101'111, // 8
+    0b111'101'111'001'111, // 9
+    0b000'010'000'010'000, // :
+    0, 0, 0, 0, 0, 0,
+    0b010'101'111'101'101, // A
+    0b110'101'110'101'110, // B
+    0b011'100'100'100'011, // C
+    0b110'101'101'101'110, // D
+    0b111'100'110'100'111, // E
+    0b111'100'110'100'100, // F
+    0b011'100'101'101'011, // G
+    0b101'101'111'101'101, // H
+    0b111'010'010'010'111, // I
+    0b001'001'001'101'010, // J
+    0b101'101'110'101'101, // K
+    0b100'100'100'100'111, // L
+    0b101'111'111'101'101, // M
+    0b110'101'101'101'101, // N
+    0b010'101'101'101'010, // O
+    0b110'101'110'100'100, // P
+    0b010'101'101'110'011, // Q
+    0b110'101'110'101'101, // R
+    0b011'100'010'001'110, // S
+    0b111'010'010'010'010, // T
+    0b101'101'101'101'111, // U
+    0b101'101'101'101'010, // V
+    0b101'101'111'111'101, // W
+    0b101'101'010'101'101, // X
+    0b101'101'010'010'010, // Y
+    0b111'001'010'100'111, // Z
+};
+
+// Host time of one frame, split by phase
+struct FrameTime {
+    double cpu, rsp, rdp, present, other;
+};
+
+bool isOverlayEnabled = false;
+
+// Drawn overlay, transparent pixels are 0
+std::array<u32, WIDTH * HEIGHT> layer;
+
+std::array<FrameTime, GRAPH_WIDTH> history;
+u64 historyHead;
+
+Clock::time_point lastRefresh;
+u64 framesSinceRefresh;
+
+// Shown numbers, updated every REFRESH_INTERVAL
+double speed, framesPerSecond, frameTime, audioFill;
+
+void init() {
+    layer.fill(0);
+}
+
+void deinit() {}
+
+void setEnabled(const bool isEnabled) {
+    if (isEnabled && !isOverlayEnabled) {
+        history.fill(FrameTime{});
+        historyHead = 0;
+
+        lastRefresh = Clock::now();
+        framesSinceRefresh = 0;
+
+        speed = framesPerSecond = frameTime = audioFill = 0.0;
+    }
+
+    isOverlayEnabled = isEnabled;
+
+    sys::perf::setTimingEnabled(isEnabled);
+}
+
+bool isEnabled() {
+    return isOverlayEnabled;
+}
+
+void toggle() {
+    setEnabled(!isOverlayEnabled);
+}
+
+void fillRect(const u32 x, const u32 y, const u32 width, const u32 height, const u32 color) {
+    for (u32 row = y; row < std::min(y + height, HEIGHT); row++) {
+        std::fill_n(&layer[row * WIDTH + x], std::min(width, WIDTH - x), color);
+    }
+}
+
+// Returns the x coordinate after the text
+u32 drawText(u32 x, const u32 y, const char *text, const u32 color) {
+    for (; *text != '\0'; text++) {
+        const u32 idx = (u32)(*text - ' ');
+
+        if ((idx < std::size(FONT)) && ((x + GLYPH_WIDTH) <= WIDTH)) {
+            const u16 glyph = FONT[idx];
+
+            for (u32 row = 0; row < GLYPH_HEIGHT; row++) {
+                for (u32 col = 0; col < GLYPH_WIDTH; col++) {
+                    const u32 bit = (GLYPH_HEIGHT - row) * GLYPH_WIDTH - col - 1;
+
+                    if ((glyph & (1 << bit)) != 0) {
+                        layer[(y + row) * WIDTH + x + col] = color;
+                    }
+                }
+            }
+        }
+
+        x += CELL_WIDTH;
+    }
+
+    return x;
+}
+
+void drawGraph() {
+    const auto toHeight = [](const double seconds) {
+        return (u32)std::min(seconds / GRAPH_SCALE * GRAPH_HEIGHT, (double)GRAPH_HEIGHT);
+    };
+
+    const u32 bottom = GRAPH_Y + GRAPH_HEIGHT;
+
+    fillRect(PADDING, bottom - toHeight(1.0 / FRAMES_PER_SECOND), GRAPH_WIDTH, 1, Color::Reference);
+
+    // Oldest frame on the left, bars stacked bottom to top
+    for (u32 col = 0; col < GRAPH_WIDTH; col++) {
+        const FrameTime &time = history[(historyHead + col) % GRAPH_WIDTH];
+
+        struct Segment {
+            double seconds;
+            u32 color;
+        };
+
+        const Segment segments[] = {
+            {time.cpu, Color::CPU},
+            {time.rsp, Color::RSP},
+            {time.rdp, Color::RDP},
+            {time.present, Color::Present},
+            {time.other, Color::Other},
+        };
+
+        double total = 0.0;
+        for (const Segment &segment : segments) {
+            const u32 y0 = bottom - toHeight(total);
+
+            total += segment.seconds;
+
+            const u32 y1 = bottom - toHeight(total);
+
+            fillRect(PADDING + col, y1, 1, y0 - y1, segment.color);
+        }
+    }
+}
+
+void update() {
+    double times[sys::perf::Phase::NumberOfPhases];
+    sys::perf::takeFrameTimes(times);
+
+    FrameTime &time = history[historyHead];
+    time.cpu = times[sys::perf::Phase::CPU];
+    time.rsp = times[sys::perf::Phase::RSP];
+    time.rdp = times[sys::perf::Phase::RDP];
+    time.present = times[sys::perf::Phase::Present];
+    time.other = times[sys::perf::Phase::Other] + times[sys::perf::Phase::PIF] + times[sys::perf::Phase::Scheduler];
+
+    historyHead = (historyHead + 1) % GRAPH_WIDTH;
+
+    framesSinceRefresh++;
+
+    const Clock::time_point now = Clock::now();
+    const double elapsed = std::chrono::duration<double>(now - lastRefresh).count();
+
+    if (elapsed >= REFRESH_INTERVAL) {
+        framesPerSecond = framesSinceRefresh / elapsed;
+        speed = 100.0 * framesPerSecond / FRAMES_PER_SECOND;
+        frameTime = 1000.0 * elapsed / framesSinceRefresh;
+        audioFill = 100.0 * sys::audio::getBufferFill();
+
+        lastRefresh = now;
+        framesSinceRefresh = 0;
+    }
+
+    layer.fill(0);
+
+    char text[32];
+
+    std::snprintf(text, sizeof(text), "SPEED %3.0f%%  %4.1f VI/S", speed, framesPerSecond);
+    drawText(PADDING, PADDING, text, Color::Text);
+
+    std::snprintf(text, sizeof(text), "FRAME %4.1f MS  AUDIO %3.0f%%", frameTime, audioFill);
+    drawText(PADDING, PADDING + CELL_HEIGHT, text, Color::Text);
+
+    u32 x = PADDING;
+    x = drawText(x, PADDING + 2 * CELL_HEIGHT, "CPU ", Color::CPU);
+    x = drawText(x, PADDING + 2 * CELL_HEIGHT, "RSP ", Color::RSP);
+    x = drawText(x, PADDING + 2 * CELL_HEIGHT, "RDP ", Color::RDP);
+    x = drawText(x, PADDING + 2 * CELL_HEIGHT, "PRESENT ", Color::Present);
+    drawText(x, PADDING + 2 * CELL_HEIGHT, "OTHER", Color::Other);
+
+    drawGraph();
+}
+
+void compose(const u32 *src, u32 *dst, const u32 width) {
+    const u32 overlayWidth = std::min(WIDTH, width);
+
+    for (u32 row = 0; row < HEIGHT; row++) {
+        const u32 *srcRow = &src[row * width];
+        const u32 *layerRow = &layer[row * WIDTH];
+
+        u32 *dstRow = &dst[row * width];
+
+        // Transparent layer pixels darken the frame, everything else replaces it
+        u32 x = 0;
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i halfMask = _mm_set1_epi32(0x7F7F7F7F);
+
+        for (; (x + 4) <= overlayWidth; x += 4) {
+            const __m128i frame = _mm_loadu_si128((const __m128i *)&srcRow[x]);
+            const __m128i over = _mm_loadu_si128((const __m128i *)&layerRow[x]);
+
+            const __m128i isTransparent = _mm_cmpeq_epi32(over, zero);
+            const __m128i darkened = _mm_and_si128(_mm_srli_epi32(frame, 1), halfMask);
+
+            _mm_storeu_si128((__m128i *)&dstRow[x], _mm_or_si128(_mm_and_si128(isTransparent, darkened), _mm_andnot_si128(isTransparent, over)));
+        }
+#endif
+
+        for (; x < overlayWidth; x++) {
+            dstRow[x] = (layerRow[x] == 0) ? ((srcRow[x] >> 1) & 0x7F7F7F7F) : layerRow[x];
+        }
+
+        std::memcpy(&dstRow[overlayWidth], &srcRow[overlayWidth], (width - overlayWidth) * sizeof(u32));
+    }
+}
+
+}
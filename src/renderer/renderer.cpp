@@ -5,6 +5,7 @@
 
 #include "renderer/renderer.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <vector>
@@ -13,7 +14,10 @@
 
 #include <SDL2/SDL.h>
 
+#include "renderer/overlay.hpp"
+
 #include "sys/memory.hpp"
+#include "sys/perf.hpp"
 
 namespace renderer {
 
@@ -35,9 +39,26 @@ struct Screen {
     SDL_Texture *texture;
 
     u32 width, height;
+
+    std::vector<u32> frameBuffer;
+
+    // Top scanlines with the overlay composited in, frameBuffer always holds the guest's pixels
+    std::vector<u32> overlayBuffer;
+    bool isOverlayShown;
+};
+
+// Last presented frame buffer, lets unchanged scanlines skip conversion and upload
+struct LastFrame {
+    u64 paddr;
+    u32 format;
+
+    u64 dirtyCursor;
+
+    bool isValid;
 };
 
 Screen screen;
+LastFrame lastFrame;
 
 void init() {
     screen.width = DEFAULT_WIDTH;
@@ -56,15 +77,26 @@ void init() {
 
     // Create texture
     screen.texture = SDL_CreateTexture(screen.renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+
+    screen.frameBuffer.resize(screen.width * screen.height);
+    screen.overlayBuffer.resize(screen.width * overlay::HEIGHT);
+
+    screen.isOverlayShown = false;
+
+    overlay::init();
 }
 
 void deinit() {
+    overlay::deinit();
+
     SDL_DestroyTexture(screen.texture);
     SDL_DestroyRenderer(screen.renderer);
     SDL_DestroyWindow(screen.window);
 }
 
-void reset() {}
+void reset() {
+    lastFrame.isValid = false;
+}
 
 void changeResolution(const u32 width) {
     if (width == screen.width) {
@@ -93,25 +125,44 @@ void changeResolution(const u32 width) {
     SDL_RenderSetLogicalSize(screen.renderer, screen.width, screen.height);
 
     screen.texture = SDL_CreateTexture(screen.renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, screen.width, screen.height);
+
+    screen.frameBuffer.resize(screen.width * screen.height);
+    screen.overlayBuffer.resize(screen.width * overlay::HEIGHT);
+
+    // New texture, has to be fully uploaded
+    lastFrame.isValid = false;
 }
 
-void drawFrameBuffer(const u64 paddr, const u32 format) {
-    std::vector<u32> frameBuffer;
-    frameBuffer.resize(screen.width * screen.height);
+u64 getPixelSize(const u32 format) {
+    if (format == Format::RGBA8888) {
+        return sizeof(u32);
+    }
+
+    return sizeof(u16);
+}
+
+// Converts scanlines [firstRow, lastRow) to RGBX8888
+void convertRows(const u64 paddr, const u32 format, const u64 firstRow, const u64 lastRow) {
+    const u64 firstPixel = firstRow * screen.width;
+    const u64 lastPixel = lastRow * screen.width;
+
+    u32 *frameBuffer = screen.frameBuffer.data();
 
     switch (format) {
         case Format::Blank:
-            std::memset(frameBuffer.data(), 0, frameBuffer.size() * sizeof(u32));
+            std::memset(&frameBuffer[firstPixel], 0, (lastPixel - firstPixel) * sizeof(u32));
             break;
         case Format::RGBA8888:
-            std::memcpy(frameBuffer.data(), sys::memory::getPointer(paddr), frameBuffer.size() * sizeof(u32));
+            sys::memory::materialize(paddr + 4 * firstPixel, (lastPixel - firstPixel) * sizeof(u32));
 
-            for (u64 i = 0; i < frameBuffer.size(); i++) {
+            std::memcpy(&frameBuffer[firstPixel], sys::memory::getPointer(paddr + 4 * firstPixel), (lastPixel - firstPixel) * sizeof(u32));
+
+            for (u64 i = firstPixel; i < lastPixel; i++) {
                 frameBuffer[i] = byteswap(frameBuffer[i]);
             }
             break;
         case Format::RGBA5551:
-            for (u64 i = 0; i < frameBuffer.size(); i++) {
+            for (u64 i = firstPixel; i < lastPixel; i++) {
                 const u16 color = sys::memory::read<u16>(paddr + 2 * i);
 
                 // Extract RGBA5551 color channels
@@ -139,9 +190,78 @@ void drawFrameBuffer(const u64 paddr, const u32 format) {
 
             exit(0);
     }
+}
+
+void drawFrameBuffer(const u64 paddr, const u32 format) {
+    sys::perf::ScopedPhase phase(sys::perf::Phase::Present);
+
+    u64 firstRow = 0;
+    u64 lastRow = screen.height;
+
+    // Same frame buffer as last time, only scanlines in pages written since then have to be converted
+    if (lastFrame.isValid && (paddr == lastFrame.paddr) && (format == lastFrame.format)) {
+        if (format == Format::Blank) {
+            lastRow = 0;
+        } else {
+            const u64 rowSize = getPixelSize(format) * screen.width;
+
+            const u64 firstPage = sys::memory::addressToPage(paddr);
+            const u64 lastPage = sys::memory::addressToPage(paddr + rowSize * screen.height - 1);
+
+            if (lastPage < sys::memory::NUM_RDRAM_PAGES) {
+                u64 firstDirtyPage = lastPage + 1;
+                u64 lastDirtyPage = firstPage;
+
+                for (u64 page = firstPage; page <= lastPage; page++) {
+                    if (sys::memory::isPageDirty(page, lastFrame.dirtyCursor)) {
+                        firstDirtyPage = std::min(firstDirtyPage, page);
+                        lastDirtyPage = page;
+                    }
+                }
+
+                if (firstDirtyPage > lastPage) {
+                    lastRow = 0;
+                } else {
+                    const u64 firstDirtyAddr = std::max(sys::memory::pageToAddress(firstDirtyPage), paddr);
+                    const u64 lastDirtyAddr = sys::memory::pageToAddress(lastDirtyPage + 1);
+
+                    firstRow = (firstDirtyAddr - paddr) / rowSize;
+                    lastRow = std::min((u64)screen.height, (lastDirtyAddr - paddr + rowSize - 1) / rowSize);
+                }
+            }
+        }
+    }
+
+    lastFrame.paddr = paddr;
+    lastFrame.format = format;
+    lastFrame.dirtyCursor = sys::memory::advanceGeneration();
+    lastFrame.isValid = true;
+
+    if (firstRow < lastRow) {
+        convertRows(paddr, format, firstRow, lastRow);
+
+        const SDL_Rect rect = {0, (int)firstRow, (int)screen.width, (int)(lastRow - firstRow)};
+
+        SDL_UpdateTexture(screen.texture, &rect, &screen.frameBuffer[firstRow * screen.width], 4 * screen.width);
+    }
+
+    // The overlay only goes into the texture, so hiding it just means uploading the guest's pixels again
+    const SDL_Rect overlayRect = {0, 0, (int)screen.width, (int)overlay::HEIGHT};
+
+    if (overlay::isEnabled()) {
+        overlay::update();
+        overlay::compose(screen.frameBuffer.data(), screen.overlayBuffer.data(), screen.width);
+
+        SDL_UpdateTexture(screen.texture, &overlayRect, screen.overlayBuffer.data(), 4 * screen.width);
+
+        screen.isOverlayShown = true;
+    } else if (screen.isOverlayShown) {
+        SDL_UpdateTexture(screen.texture, &overlayRect, screen.frameBuffer.data(), 4 * screen.width);
+
+        screen.isOverlayShown = false;
+    }
 
-    // Draw frame buffer
-    SDL_UpdateTexture(screen.texture, nullptr, frameBuffer.data(), 4 * screen.width);
+    // Still present every frame, presentation paces emulation through VSync
     SDL_RenderClear(screen.renderer);
     SDL_RenderCopy(screen.renderer, screen.texture, nullptr, nullptr);
     SDL_RenderPresent(screen.renderer);
@@ -5,6 +5,7 @@
 
 #include "sys/audio.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -35,6 +36,8 @@ u64 audioReadIdx, audioWriteIdx;
 
 u64 idDoSample;
 
+bool isAudioMuted = false;
+
 void init() {
     // Initialize audio subsystem
     SDL_Init(SDL_INIT_AUDIO);
@@ -56,7 +59,7 @@ void init() {
 
     SDL_PauseAudioDevice(audioDev, 0);
 
-    idDoSample = scheduler::registerEvent([](int) { doSample(); });
+    idDoSample = scheduler::registerEvent("Audio sample", [](int) { doSample(); });
 }
 
 void deinit() {}
@@ -69,6 +72,32 @@ void reset() {
     scheduler::addEvent(idDoSample, 0, CYCLES_PER_AUDIO_FRAME);
 }
 
+void doSavestate(savestate::State &state) {
+    if (!state.hasFlag(savestate::StateFlag::Audio)) {
+        return;
+    }
+
+    // Keep the audio callback from reading a half-loaded buffer
+    SDL_LockAudioDevice(audioDev);
+
+    state.doBytes(audioData.data(), SAMPLE_BUFFER_SIZE * sizeof(i16));
+    state.doPOD(audioReadIdx);
+    state.doPOD(audioWriteIdx);
+
+    SDL_UnlockAudioDevice(audioDev);
+}
+
+void setMuted(const bool isMuted) {
+    isAudioMuted = isMuted;
+}
+
+double getBufferFill() {
+    // The audio callback advances the read index on its own thread, a stale value is fine here
+    const i64 queuedSamples = (i64)(audioWriteIdx - audioReadIdx);
+
+    return std::clamp((double)queuedSamples / SAMPLE_BUFFER_SIZE, 0.0, 1.0);
+}
+
 void audioCallback(void *userData, u8 *buffer, int length) {
     (void)userData;
 
@@ -84,6 +113,10 @@ void audioCallback(void *userData, u8 *buffer, int length) {
 }
 
 void pushSamples(const i16 left, const i16 right) {
+    if (isAudioMuted) {
+        return;
+    }
+
     audioData[(audioWriteIdx + 0) & SAMPLE_BUFFER_MASK] = left;
     audioData[(audioWriteIdx + 1) & SAMPLE_BUFFER_MASK] = right;
 
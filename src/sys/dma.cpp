@@ -0,0 +1,98 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/dma.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ios>
+
+#include <plog/Log.h>
+
+#include "sys/memory.hpp"
+
+namespace sys::dma {
+
+// Calls func(RDRAM address, local address, size) for every contiguous segment of a transfer
+template<typename Func>
+void forEachSegment(const Transfer &transfer, Func func) {
+    u64 dramaddr = transfer.dramaddr;
+    u64 localAddr = transfer.localAddr;
+
+    for (u64 row = 0; row < transfer.count; row++) {
+        u64 rowAddr = dramaddr;
+        u64 remaining = transfer.length;
+
+        while (remaining > 0) {
+            if (rowAddr >= memory::MemorySize::RDRAM) {
+                PLOG_WARNING << "DMA outside of RDRAM (address = " << std::hex << rowAddr << ")";
+
+                return;
+            }
+
+            u64 size = std::min(remaining, memory::MemorySize::RDRAM - rowAddr);
+
+            if (transfer.isLocalWrapping) {
+                size = std::min(size, transfer.localSize - localAddr);
+            }
+
+            func(rowAddr, localAddr, size);
+
+            rowAddr += size;
+            remaining -= size;
+
+            localAddr += size;
+
+            if (transfer.isLocalWrapping && (localAddr == transfer.localSize)) {
+                localAddr = 0;
+            }
+        }
+
+        dramaddr += transfer.length + transfer.skip;
+    }
+}
+
+void copyToRDRAM(const Transfer &transfer) {
+    u8 *rdram = memory::getPointer(memory::MemoryBase::RDRAM);
+
+    forEachSegment(transfer, [&](const u64 dramaddr, const u64 localAddr, const u64 size) {
+        memory::materialize(dramaddr, size);
+
+        // Anything past the end of local memory reads as 0
+        u64 validSize = 0;
+        if (localAddr < transfer.localSize) {
+            validSize = std::min(size, transfer.localSize - localAddr);
+
+            std::memcpy(&rdram[dramaddr], &transfer.local[localAddr], validSize);
+        }
+
+        std::memset(&rdram[dramaddr + validSize], 0, size - validSize);
+
+        memory::markDirty(dramaddr, size);
+    });
+}
+
+void copyFromRDRAM(const Transfer &transfer) {
+    const u8 *rdram = memory::getPointer(memory::MemoryBase::RDRAM);
+
+    forEachSegment(transfer, [&](const u64 dramaddr, const u64 localAddr, const u64 size) {
+        memory::materialize(dramaddr, size);
+
+        // Writes past the end of local memory are dropped
+        if (localAddr < transfer.localSize) {
+            std::memcpy(&transfer.local[localAddr], &rdram[dramaddr], std::min(size, transfer.localSize - localAddr));
+        }
+    });
+}
+
+u64 getEndAddress(const Transfer &transfer) {
+    if (transfer.count == 0) {
+        return transfer.dramaddr;
+    }
+
+    return transfer.dramaddr + (transfer.count - 1) * (transfer.length + transfer.skip) + transfer.length;
+}
+
+}
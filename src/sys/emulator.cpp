@@ -5,11 +5,16 @@
 
 #include "sys/emulator.hpp"
 
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 #include <plog/Log.h>
 
 #include <SDL2/SDL.h>
 
 #include "hw/ai.hpp"
+#include "hw/cart.hpp"
 #include "hw/cic.hpp"
 #include "hw/dp.hpp"
 #include "hw/mi.hpp"
@@ -19,18 +24,30 @@
 #include "hw/sp.hpp"
 #include "hw/vi.hpp"
 #include "hw/cpu/cpu.hpp"
+#include "hw/pif/boot.hpp"
 #include "hw/pif/joybus.hpp"
 #include "hw/pif/memory.hpp"
+#include "hw/pif/pak.hpp"
 #include "hw/pif/pif.hpp"
 #include "hw/rdp/rasterizer.hpp"
 #include "hw/rdp/rdp.hpp"
+#include "hw/rsp/capture.hpp"
 #include "hw/rsp/rsp.hpp"
 
+#include "renderer/overlay.hpp"
 #include "renderer/renderer.hpp"
 
 #include "sys/audio.hpp"
 #include "sys/memory.hpp"
+#include "sys/movie.hpp"
+#include "sys/perf.hpp"
+#include "sys/rewind.hpp"
+#include "sys/savefile.hpp"
+#include "sys/savestate.hpp"
 #include "sys/scheduler.hpp"
+#include "sys/stats.hpp"
+#include "sys/trace.hpp"
+#include "sys/watchpoint.hpp"
 
 namespace sys::emulator {
 
@@ -54,35 +71,100 @@ namespace ControllerButton {
     };
 }
 
+struct KeyMapping {
+    SDL_Keycode key;
+    u32 button;
+};
+
+constexpr KeyMapping KEY_MAP[] = {
+    {SDLK_d, ControllerButton::DpadRight},
+    {SDLK_a, ControllerButton::DpadLeft},
+    {SDLK_s, ControllerButton::DpadDown},
+    {SDLK_w, ControllerButton::DpadUp},
+    {SDLK_SPACE, ControllerButton::Start},
+    {SDLK_m, ControllerButton::Z},
+    {SDLK_b, ControllerButton::B},
+    {SDLK_n, ControllerButton::A},
+    {SDLK_q, ControllerButton::LeftTrigger},
+    {SDLK_e, ControllerButton::RightTrigger},
+    {SDLK_u, ControllerButton::CUp},
+    {SDLK_j, ControllerButton::CDown},
+    {SDLK_h, ControllerButton::CLeft},
+    {SDLK_k, ControllerButton::CRight},
+};
+
 u32 buttonState;
 
+std::string statePath;
+
+bool isFastBoot;
 bool isRunning;
 
+// Save states are only safe to take between run slices
+bool isSaveStateRequested, isLoadStateRequested;
+
+bool isFrameFinished;
+
+bool isRewindEnabled = false;
+bool isRewinding;
+
+// Run-ahead state, reused every frame so snapshots don't allocate
+std::vector<u8> runAheadState;
+
+int runAheadFrames = 0;
+int runAheadFramesLeft = 0;
+
 void init(const char *bootPath, const char *pifPath, const char *romPath) {
-    PLOG_INFO << "Boot ROM path = " << bootPath;
-    PLOG_INFO << "PIF-NUS ROM path = " << pifPath;
+    // Skip the boot ROM and IPL3 if no boot ROM was provided
+    isFastBoot = bootPath == NULL;
+
+    if (isFastBoot) {
+        PLOG_INFO << "No boot ROM, using fast boot";
+    } else {
+        PLOG_INFO << "Boot ROM path = " << bootPath;
+    }
+
+    if (pifPath == NULL) {
+        PLOG_INFO << "No PIF-NUS ROM, using PIF HLE";
+    } else {
+        PLOG_INFO << "PIF-NUS ROM path = " << pifPath;
+    }
+
     PLOG_INFO << "ROM path = " << romPath;
 
+    statePath = std::string(romPath) + ".state";
+
     renderer::init();
 
     sys::memory::init(bootPath, romPath);
     sys::scheduler::init();
 
     sys::audio::init();
+    sys::savestate::init();
+    sys::rewind::init();
+    sys::savefile::init();
+    sys::movie::init();
+    sys::watchpoint::init();
+    sys::stats::init();
+    sys::perf::init();
+    sys::trace::init();
 
     hw::pif::memory::init(pifPath);
 
     hw::cpu::init();
     hw::ai::init();
+    hw::cart::init(romPath);
     hw::cic::init();
     hw::dp::init();
     hw::mi::init();
     hw::pi::init();
-    hw::pif::init();
+    hw::pif::init(pifPath == NULL);
     hw::pif::joybus::init();
+    hw::pif::pak::init(romPath);
     hw::rdp::init();
     hw::rdp::rasterizer::init();
     hw::rsp::init();
+    hw::rsp::capture::init();
     hw::ri::init();
     hw::si::init();
     hw::sp::init();
@@ -96,45 +178,153 @@ void deinit() {
     sys::scheduler::deinit();
 
     sys::audio::deinit();
+    sys::savestate::deinit();
+    sys::rewind::deinit();
+    sys::movie::deinit();
+    sys::watchpoint::deinit();
+    sys::stats::deinit();
+    sys::perf::deinit();
+    sys::trace::deinit();
 
     hw::pif::memory::deinit();
 
     hw::cpu::deinit();
     hw::ai::deinit();
+    hw::cart::deinit();
     hw::cic::deinit();
     hw::dp::deinit();
     hw::mi::deinit();
     hw::pi::deinit();
     hw::pif::deinit();
     hw::pif::joybus::deinit();
+    hw::pif::pak::deinit();
     hw::rdp::deinit();
     hw::rdp::rasterizer::deinit();
     hw::rsp::deinit();
+    hw::rsp::capture::deinit();
     hw::ri::deinit();
     hw::si::deinit();
     hw::sp::deinit();
     hw::vi::deinit();
 
+    // After the cartridge and paks have closed their save files
+    sys::savefile::deinit();
+
     renderer::deinit();
 
     SDL_Quit();
 }
 
-void run() {
-    // Give PIF-NUS a headstart to simulate the slowness of excuting code from the boot ROM
-    hw::pif::run(scheduler::CPU_FREQUENCY / 60 / 6);
+bool usesFastBoot() {
+    return isFastBoot;
+}
 
-    while (isRunning) {
-        const i64 cycles = scheduler::getRunCycles();
+void setRunAheadFrames(const int frames) {
+    runAheadFrames = frames;
+
+    if (runAheadFrames > 0) {
+        PLOG_INFO << "Run-ahead frames = " << runAheadFrames;
+    }
+}
+
+void setRewindEnabled(const bool isEnabled) {
+    isRewindEnabled = isEnabled;
+}
+
+// Runs every component for one scheduler slice
+void runSlice() {
+    const i64 cycles = scheduler::getRunCycles();
+
+    {
+        perf::ScopedPhase phase(perf::Phase::CPU);
 
-        hw::pif::run(cycles / 6);
         hw::cpu::run(cycles);
+    }
+
+    {
+        perf::ScopedPhase phase(perf::Phase::RSP);
+
         hw::rsp::run(cycles / 2); // TODO: not correct, will fix later
+    }
+
+    {
+        perf::ScopedPhase phase(perf::Phase::Scheduler);
 
         scheduler::run(cycles);
     }
 }
 
+// Emulates ahead with the current input, presents the last frame, then goes back in time
+void runAhead() {
+    savestate::saveToBuffer(runAheadState, savestate::StateFlag::RDRAM | savestate::StateFlag::SaveData);
+
+    // Statistics aren't part of save states, keep frames that get thrown away out of them
+    const stats::Counters counters = stats::counters;
+
+    sys::audio::setMuted(true);
+
+    runAheadFramesLeft = runAheadFrames;
+
+    while (isRunning && (runAheadFramesLeft > 0)) {
+        runSlice();
+    }
+
+    sys::audio::setMuted(false);
+
+    if (!savestate::loadFromBuffer(runAheadState, savestate::StateFlag::RDRAM | savestate::StateFlag::SaveData)) {
+        PLOG_FATAL << "Failed to restore run-ahead state";
+
+        exit(0);
+    }
+
+    stats::counters = counters;
+
+    isFrameFinished = false;
+}
+
+void run() {
+    // Give PIF-NUS a headstart to simulate the slowness of excuting code from the boot ROM
+    hw::pif::run(scheduler::CPU_FREQUENCY / 60);
+
+    // Fast boot has to wait for PIF-NUS to finish initializing PIF RAM
+    if (isFastBoot) {
+        hw::pif::boot::run();
+    }
+
+    while (isRunning) {
+        if (isSaveStateRequested) {
+            isSaveStateRequested = false;
+
+            savestate::save(statePath.c_str());
+        }
+
+        if (isLoadStateRequested) {
+            isLoadStateRequested = false;
+
+            savestate::load(statePath.c_str());
+        }
+
+        runSlice();
+
+        if (isFrameFinished) {
+            isFrameFinished = false;
+
+            // Step back one frame at a time while the rewind key is held
+            if (isRewindEnabled) {
+                if (isRewinding) {
+                    rewind::popCheckpoint();
+                } else {
+                    rewind::pushCheckpoint();
+                }
+            }
+
+            if (runAheadFrames > 0) {
+                runAhead();
+            }
+        }
+    }
+}
+
 void reset() {
     renderer::reset();
 
@@ -142,17 +332,24 @@ void reset() {
     sys::scheduler::reset();
 
     sys::audio::reset();
+    sys::savestate::reset();
+    sys::rewind::reset();
+    sys::savefile::reset();
+    sys::movie::reset();
+    sys::stats::reset();
 
     hw::pif::memory::reset();
 
     hw::cpu::reset();
     hw::ai::reset();
+    hw::cart::reset();
     hw::cic::reset();
     hw::dp::reset();
     hw::mi::reset();
     hw::pi::reset();
     hw::pif::reset();
     hw::pif::joybus::reset();
+    hw::pif::pak::reset();
     hw::rdp::reset();
     hw::rdp::rasterizer::reset();
     hw::rsp::reset();
@@ -162,23 +359,51 @@ void reset() {
     hw::vi::reset();
 
     buttonState = 0;
+
+    isSaveStateRequested = isLoadStateRequested = false;
+
+    isFrameFinished = isRewinding = false;
+
+    runAheadFramesLeft = 0;
+}
+
+void doSavestate(savestate::State &state) {
+    state.doPOD(buttonState);
 }
 
 u32 getButtonState() {
+    // Sample input right when the game polls it. Frames emulated ahead reuse the last sample
+    if (runAheadFramesLeft == 0) {
+        updateButtonState();
+    }
+
     return buttonState;
 }
 
 void finishFrame() {
-    renderer::drawFrameBuffer(hw::vi::getOrigin(), hw::vi::getFormat());
+    // Frames emulated ahead reuse the last input, only the final one is presented
+    if (runAheadFramesLeft > 0) {
+        if (--runAheadFramesLeft == 0) {
+            renderer::drawFrameBuffer(hw::vi::getOrigin(), hw::vi::getFormat());
+        }
 
-    updateButtonState();
-}
+        return;
+    }
 
-void updateButtonState() {
-    const u8 *keyState = SDL_GetKeyboardState(NULL);
+    if (runAheadFrames == 0) {
+        renderer::drawFrameBuffer(hw::vi::getOrigin(), hw::vi::getFormat());
+    }
 
-    buttonState = 0;
+    sys::stats::onFrame();
+    sys::trace::onFrame();
+
+    pollEvents();
+    updateButtonState();
 
+    isFrameFinished = true;
+}
+
+void pollEvents() {
     SDL_Event event;
     while (SDL_PollEvent(&event) != 0) {
         switch (event.type) {
@@ -186,66 +411,38 @@ void updateButtonState() {
                 isRunning = false;
                 break;
             case SDL_KEYDOWN:
-                if (keyState[SDL_GetScancodeFromKey(SDLK_d)] != 0) {
-                    buttonState |= ControllerButton::DpadRight;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_a)] != 0) {
-                    buttonState |= ControllerButton::DpadLeft;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_s)] != 0) {
-                    buttonState |= ControllerButton::DpadDown;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_w)] != 0) {
-                    buttonState |= ControllerButton::DpadUp;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_SPACE)] != 0) {
-                    buttonState |= ControllerButton::Start;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_m)] != 0) {
-                    buttonState |= ControllerButton::Z;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_b)] != 0) {
-                    buttonState |= ControllerButton::B;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_n)] != 0) {
-                    buttonState |= ControllerButton::A;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_q)] != 0) {
-                    buttonState |= ControllerButton::LeftTrigger;
-                }
-
-                if (keyState[SDL_GetScancodeFromKey(SDLK_e)] != 0) {
-                    buttonState |= ControllerButton::RightTrigger;
+                // Save state hotkeys
+                if (event.key.keysym.sym == SDLK_F5) {
+                    isSaveStateRequested = true;
+                } else if (event.key.keysym.sym == SDLK_F7) {
+                    isLoadStateRequested = true;
+                } else if (event.key.keysym.sym == SDLK_F9) {
+                    sys::trace::toggle();
+                } else if (event.key.keysym.sym == SDLK_F10) {
+                    renderer::overlay::toggle();
                 }
+                break;
+            default:
+                break;
+        }
+    }
+}
 
-                if (keyState[SDL_GetScancodeFromKey(SDLK_u)] != 0) {
-                    buttonState |= ControllerButton::CUp;
-                }
+// Hotkeys and quit are handled once per frame by pollEvents(), this only refreshes the keyboard state
+void updateButtonState() {
+    SDL_PumpEvents();
 
-                if (keyState[SDL_GetScancodeFromKey(SDLK_j)] != 0) {
-                    buttonState |= ControllerButton::CDown;
-                }
+    const u8 *keyState = SDL_GetKeyboardState(NULL);
 
-                if (keyState[SDL_GetScancodeFromKey(SDLK_h)] != 0) {
-                    buttonState |= ControllerButton::CLeft;
-                }
+    buttonState = 0;
 
-                if (keyState[SDL_GetScancodeFromKey(SDLK_k)] != 0) {
-                    buttonState |= ControllerButton::CRight;
-                }
-                break;
-            default:
-                break;
+    for (const KeyMapping &mapping : KEY_MAP) {
+        if (keyState[SDL_GetScancodeFromKey(mapping.key)] != 0) {
+            buttonState |= mapping.button;
         }
     }
+
+    isRewinding = keyState[SDL_GetScancodeFromKey(SDLK_BACKSPACE)] != 0;
 }
 
 }
@@ -5,16 +5,20 @@
 
 #include "sys/memory.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ios>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <plog/Log.h>
 
 #include "hw/ai.hpp"
+#include "hw/cart.hpp"
 #include "hw/dp.hpp"
 #include "hw/mi.hpp"
 #include "hw/pi.hpp"
@@ -24,12 +28,18 @@
 #include "hw/vi.hpp"
 #include "hw/pif/pif.hpp"
 
+#include "sys/stats.hpp"
+#include "sys/watchpoint.hpp"
+
 namespace sys::memory {
 
-constexpr u64 NUM_PAGES = MemorySize::AddressSpace >> PAGE_SHIFT;
+std::array<RegionTable *, NUM_REGIONS> pageTable;
+
+// Shared by all regions that have nothing mapped, never written to
+RegionTable emptyRegion;
 
-// Page table for software fastmem
-std::array<u8 *, NUM_PAGES> pageTable;
+// Tables of regions with mapped memory, only allocated on first map
+std::vector<std::unique_ptr<RegionTable>> regionTables;
 
 // Memory arrays
 
@@ -40,35 +50,59 @@ std::array<u8, MemorySize::PIF_ROM> pifROM;
 
 std::vector<u8> rom;
 
+// Source of a pending lazy DMA for every RDRAM page, NULL if there is none
+std::array<const u8 *, NUM_RDRAM_PAGES> lazySources;
+
+u64 lazyPageNum;
+
+// Pages redirected to the slow path by watchpoints, and the memory they map to (NULL for I/O)
+std::unordered_map<u64, u8 *> watchedPages;
+
+std::array<u64, NUM_RDRAM_PAGES> pageGenerations;
+
+u64 generation;
+
 void init(const char *bootPath, const char *romPath) {
-    // Read boot ROM
-    FILE *file = std::fopen(bootPath, "rb");
-    if (file == NULL) {
-        PLOG_FATAL << "Unable to open boot ROM file";
+    emptyRegion.fill(NULL);
 
-        exit(0);
-    }
+    pageTable.fill(&emptyRegion);
 
-    // Read file
-    std::fread(pifROM.data(), sizeof(u8), MemorySize::PIF_ROM, file);
-    std::fclose(file);
+    // Read boot ROM. Not needed if the boot process is high-level emulated
+    if (bootPath != NULL) {
+        FILE *file = std::fopen(bootPath, "rb");
+        if (file == NULL) {
+            PLOG_FATAL << "Unable to open boot ROM file";
 
-    // Read ROM
-    file = std::fopen(romPath, "rb");
-    if (file == NULL) {
-        PLOG_FATAL << "Unable to open ROM file";
+            exit(0);
+        }
 
-        exit(0);
+        // Read file
+        std::fread(pifROM.data(), sizeof(u8), MemorySize::PIF_ROM, file);
+        std::fclose(file);
+    } else {
+        pifROM.fill(0);
     }
 
-    // Get file size
-    std::fseek(file, 0, SEEK_END);
-    rom.resize(std::ftell(file));
-    std::fseek(file, 0, SEEK_SET);
+    // Read ROM. Tools that don't emulate the CPU run without one
+    if (romPath != NULL) {
+        FILE *file = std::fopen(romPath, "rb");
+        if (file == NULL) {
+            PLOG_FATAL << "Unable to open ROM file";
 
-    // Read file
-    std::fread(rom.data(), sizeof(u8), rom.size(), file);
-    std::fclose(file);
+            exit(0);
+        }
+
+        // Get file size
+        std::fseek(file, 0, SEEK_END);
+        rom.resize(std::ftell(file));
+        std::fseek(file, 0, SEEK_SET);
+
+        // Read file
+        std::fread(rom.data(), sizeof(u8), rom.size(), file);
+        std::fclose(file);
+    } else {
+        rom.clear();
+    }
 
     // Map all memory regions
     map(MemoryBase::RDRAM, MemorySize::RDRAM, rdram.data());
@@ -77,14 +111,92 @@ void init(const char *bootPath, const char *romPath) {
     map(MemoryBase::CART_DOM1_A2, rom.size(), rom.data());
 }
 
-void deinit() {}
+void deinit() {
+    watchedPages.clear();
+    regionTables.clear();
+}
 
 void run() {}
 
-void reset() {}
+void reset() {
+    lazySources.fill(NULL);
+
+    lazyPageNum = 0;
+
+    map(MemoryBase::RDRAM, MemorySize::RDRAM, rdram.data());
+
+    // Everything is dirty relative to a fresh cursor (0)
+    generation = 1;
+
+    pageGenerations.fill(generation);
+}
+
+// Returns true if src points into the ROM
+bool isROMPointer(const u8 *src) {
+    return (src >= rom.data()) && (src < (rom.data() + rom.size()));
+}
+
+void doSavestate(savestate::State &state) {
+    if (state.hasFlag(savestate::StateFlag::RDRAM)) {
+        // Pending lazy pages are stored as their ROM offset + 1 and stay lazy, 0 means the page data follows.
+        // Run-ahead and rewind take snapshots every frame, materializing here would defeat lazy DMA
+        for (u64 page = 0; page < NUM_RDRAM_PAGES; page++) {
+            const u64 offset = pageToAddress(page);
+
+            u64 lazyOffset = 0;
+
+            if (!state.isLoading()) {
+                if (isROMPointer(lazySources[page])) {
+                    lazyOffset = (u64)(lazySources[page] - rom.data()) + 1;
+                } else {
+                    materializeLazyPage(page);
+                }
+            }
+
+            state.doPOD(lazyOffset);
+
+            if (!state.isLoading()) {
+                if (lazyOffset == 0) {
+                    state.doBytes(&rdram[offset], PAGE_SIZE);
+                }
 
-u64 addressToPage(const u64 addr) {
-    return addr >> PAGE_SHIFT;
+                continue;
+            }
+
+            if (lazyOffset != 0) {
+                if ((lazyOffset - 1 + PAGE_SIZE) > rom.size()) {
+                    state.invalidate();
+
+                    return;
+                }
+
+                const u8 *src = &rom[lazyOffset - 1];
+
+                if (lazySources[page] != src) {
+                    setLazyPage(page, src);
+                }
+
+                continue;
+            }
+
+            u8 data[PAGE_SIZE];
+            state.doBytes(data, PAGE_SIZE);
+
+            // Only overwrite pages that actually change, keeps dirty tracking precise
+            if (lazySources[page] != NULL) {
+                setLazyPage(page, NULL);
+
+                std::memcpy(&rdram[offset], data, PAGE_SIZE);
+            } else if (std::memcmp(&rdram[offset], data, PAGE_SIZE) != 0) {
+                std::memcpy(&rdram[offset], data, PAGE_SIZE);
+
+                pageGenerations[page] = generation;
+            }
+        }
+    }
+
+    state.doPOD(dmem);
+    state.doPOD(imem);
 }
 
 constexpr u64 addressToIOPage(const u64 addr) {
@@ -93,12 +205,32 @@ constexpr u64 addressToIOPage(const u64 addr) {
     return addr >> IO_SHIFT;
 }
 
-u64 pageToAddress(const u64 page) {
-    return page << PAGE_SHIFT;
+void setPage(const u64 page, u8 *mem) {
+    const u64 region = page >> (REGION_SHIFT - PAGE_SHIFT);
+
+    if (pageTable[region] == &emptyRegion) {
+        if (mem == NULL) {
+            return;
+        }
+
+        regionTables.push_back(std::make_unique<RegionTable>());
+        regionTables.back()->fill(NULL);
+
+        pageTable[region] = regionTables.back().get();
+    }
+
+    (*pageTable[region])[page & (PAGES_PER_REGION - 1)] = mem;
 }
 
-bool isValidPhysicalAddress(const u64 paddr) {
-    return paddr < MemorySize::AddressSpace;
+// Like setPage(), but watched pages stay redirected to the slow path
+void mapPage(const u64 page, u8 *mem) {
+    if (const auto it = watchedPages.find(page); it != watchedPages.end()) {
+        it->second = mem;
+
+        return;
+    }
+
+    setPage(page, mem);
 }
 
 void map(const u64 paddr, const u64 size, u8 *mem) {
@@ -108,8 +240,217 @@ void map(const u64 paddr, const u64 size, u8 *mem) {
     const u64 endPage = page + pageNum;
 
     for (u64 i = page; i < endPage; i++) {
-        pageTable[i] = &mem[pageToAddress(i - page)];
+        mapPage(i, &mem[pageToAddress(i - page)]);
+    }
+}
+
+void watchPage(const u64 page) {
+    if (watchedPages.contains(page)) {
+        return;
+    }
+
+    watchedPages[page] = getPage(page);
+
+    setPage(page, NULL);
+}
+
+void unwatchPage(const u64 page) {
+    const auto it = watchedPages.find(page);
+    if (it == watchedPages.end()) {
+        return;
+    }
+
+    setPage(page, it->second);
+
+    watchedPages.erase(it);
+}
+
+bool isPageWatched(const u64 page) {
+    return !watchedPages.empty() && watchedPages.contains(page);
+}
+
+bool isRangeWatched(const u64 paddr, const u64 size) {
+    if (watchedPages.empty() || (size == 0)) {
+        return false;
+    }
+
+    for (u64 page = addressToPage(paddr); page <= addressToPage(paddr + size - 1); page++) {
+        if (watchedPages.contains(page)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<typename T>
+bool readWatched(const u64 paddr, T &data) {
+    const auto it = watchedPages.find(addressToPage(paddr));
+    if (it == watchedPages.end()) {
+        return false;
+    }
+
+    watchpoint::check(paddr, sizeof(T), watchpoint::AccessType::Read);
+
+    // I/O is left to the regular slow path
+    if (it->second == NULL) {
+        return false;
+    }
+
+    std::memcpy(&data, &it->second[paddr & PAGE_MASK], sizeof(T));
+
+    data = byteswap(data);
+
+    return true;
+}
+
+template<typename T>
+bool writeWatched(const u64 paddr, const T data) {
+    const auto it = watchedPages.find(addressToPage(paddr));
+    if (it == watchedPages.end()) {
+        return false;
+    }
+
+    watchpoint::check(paddr, sizeof(T), watchpoint::AccessType::Write);
+
+    if (it->second == NULL) {
+        return false;
+    }
+
+    const T swappedData = byteswap(data);
+    std::memcpy(&it->second[paddr & PAGE_MASK], &swappedData, sizeof(T));
+
+    stampPage(it->first);
+
+    return true;
+}
+
+u64 getROMSize() {
+    return rom.size();
+}
+
+void markDirty(const u64 paddr, const u64 size) {
+    if (size == 0) {
+        return;
     }
+
+    const u64 lastPage = addressToPage(paddr + size - 1);
+
+    for (u64 page = addressToPage(paddr); page <= lastPage; page++) {
+        stampPage(page);
+    }
+}
+
+bool materializeLazyPage(const u64 page) {
+    if ((page >= NUM_RDRAM_PAGES) || (lazySources[page] == NULL)) {
+        return false;
+    }
+
+    const u64 offset = pageToAddress(page);
+
+    std::memcpy(&rdram[offset], lazySources[page], PAGE_SIZE);
+
+    lazySources[page] = NULL;
+    lazyPageNum--;
+
+    mapPage(page, &rdram[offset]);
+
+    return true;
+}
+
+void materialize(const u64 paddr, const u64 size) {
+    if ((lazyPageNum == 0) || (size == 0) || (paddr >= MemorySize::RDRAM)) {
+        return;
+    }
+
+    const u64 lastPage = std::min(addressToPage(paddr + size - 1), NUM_RDRAM_PAGES - 1);
+
+    for (u64 page = addressToPage(paddr); page <= lastPage; page++) {
+        materializeLazyPage(page);
+    }
+}
+
+void materializeAll() {
+    materialize(MemoryBase::RDRAM, MemorySize::RDRAM);
+}
+
+const u8 *getLazySource(const u64 page) {
+    return lazySources[page];
+}
+
+const u8 *getPageContents(const u64 page) {
+    if (lazySources[page] != NULL) {
+        return lazySources[page];
+    }
+
+    return &rdram[pageToAddress(page)];
+}
+
+void setLazyPage(const u64 page, const u8 *src) {
+    if ((lazySources[page] == NULL) && (src != NULL)) {
+        lazyPageNum++;
+    } else if ((lazySources[page] != NULL) && (src == NULL)) {
+        lazyPageNum--;
+    }
+
+    lazySources[page] = src;
+
+    if (src == NULL) {
+        mapPage(page, &rdram[pageToAddress(page)]);
+    } else {
+        setPage(page, NULL);
+    }
+
+    stampPage(page);
+}
+
+void copyLazy(const u64 paddr, const u8 *src, const u64 size) {
+    // Partial pages at either end are copied right away
+    const u64 lazyStart = std::min((paddr + PAGE_MASK) & ~(u64)PAGE_MASK, paddr + size);
+    const u64 lazyEnd = std::max((paddr + size) & ~(u64)PAGE_MASK, lazyStart);
+
+    materialize(paddr, lazyStart - paddr);
+    materialize(lazyEnd, paddr + size - lazyEnd);
+
+    std::memcpy(&rdram[paddr], src, lazyStart - paddr);
+    std::memcpy(&rdram[lazyEnd], &src[lazyEnd - paddr], paddr + size - lazyEnd);
+
+    for (u64 page = addressToPage(lazyStart); page < addressToPage(lazyEnd); page++) {
+        // Pending copies are fully overwritten, no need to materialize them first
+        if (lazySources[page] == NULL) {
+            lazyPageNum++;
+        }
+
+        lazySources[page] = &src[pageToAddress(page) - paddr];
+
+        setPage(page, NULL);
+    }
+
+    markDirty(paddr, size);
+}
+
+u64 advanceGeneration() {
+    return generation++;
+}
+
+bool isPageDirty(const u64 page, const u64 cursor) {
+    return pageGenerations[page] > cursor;
+}
+
+bool isRangeDirty(const u64 paddr, const u64 size, const u64 cursor) {
+    if (size == 0) {
+        return false;
+    }
+
+    const u64 lastPage = std::min(addressToPage(paddr + size - 1), NUM_RDRAM_PAGES - 1);
+
+    for (u64 page = addressToPage(paddr); page <= lastPage; page++) {
+        if (isPageDirty(page, cursor)) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 u8 *getPointer(const u64 paddr) {
@@ -119,12 +460,24 @@ u8 *getPointer(const u64 paddr) {
         exit(0);
     }
 
+    // Lazy DMA pages are unmapped, callers have to materialize the range they touch
+    if (paddr < MemorySize::RDRAM) {
+        return &rdram[paddr];
+    }
+
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
+    u8 *mem = getPage(page);
+
+    // DMAs don't trigger watchpoints
+    if (const auto it = watchedPages.find(page); it != watchedPages.end()) {
+        mem = it->second;
+    }
+
+    if (mem != NULL) {
         const u64 offset = paddr & PAGE_MASK;
 
-        return &pageTable[page][offset];
+        return &mem[offset];
     }
 
     PLOG_FATAL << "Unrecognized physical address " << std::hex << paddr;
@@ -133,7 +486,7 @@ u8 *getPointer(const u64 paddr) {
 }
 
 template<>
-u8 read(const u64 paddr) {
+[[gnu::cold, gnu::noinline]] u8 readSlow(const u64 paddr) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -142,10 +495,13 @@ u8 read(const u64 paddr) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return read<u8>(paddr);
+    }
 
-        return pageTable[page][offset];
+    if (u8 data; readWatched(paddr, data)) {
+        return data;
     }
 
     if ((paddr >= MemoryBase::PIF_ROM) && (paddr < (MemoryBase::PIF_ROM + MemorySize::PIF_ROM))) {
@@ -163,7 +519,7 @@ u8 read(const u64 paddr) {
 }
 
 template<>
-u16 read(const u64 paddr) {
+[[gnu::cold, gnu::noinline]] u16 readSlow(const u64 paddr) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -172,13 +528,13 @@ u16 read(const u64 paddr) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
-
-        u16 data;
-        std::memcpy(&data, &pageTable[page][offset], sizeof(u16));
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return read<u16>(paddr);
+    }
 
-        return byteswap(data);
+    if (u16 data; readWatched(paddr, data)) {
+        return data;
     }
 
     if ((paddr >= MemoryBase::PIF_ROM) && (paddr < (MemoryBase::PIF_ROM + MemorySize::PIF_ROM))) {
@@ -198,7 +554,7 @@ u16 read(const u64 paddr) {
 }
 
 template<>
-u32 read(const u64 paddr) {
+[[gnu::cold, gnu::noinline]] u32 readSlow(const u64 paddr) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -207,13 +563,13 @@ u32 read(const u64 paddr) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
-
-        u32 data;
-        std::memcpy(&data, &pageTable[page][offset], sizeof(u32));
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return read<u32>(paddr);
+    }
 
-        return byteswap(data);
+    if (u32 data; readWatched(paddr, data)) {
+        return data;
     }
 
     if ((paddr >= MemoryBase::PIF_ROM) && (paddr < (MemoryBase::PIF_ROM + MemorySize::PIF_ROM))) {
@@ -227,12 +583,16 @@ u32 read(const u64 paddr) {
         return byteswap(hw::pif::read<u32>(paddr));
     }
 
+    if ((paddr >= MemoryBase::CART_DOM2_A2) && (paddr < MemoryBase::CART_DOM1_A2)) {
+        return hw::cart::read(paddr);
+    }
+
     // Try to read I/O
     return readIO(paddr);
 }
 
 template<>
-u64 read(const u64 paddr) {
+[[gnu::cold, gnu::noinline]] u64 readSlow(const u64 paddr) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -241,13 +601,13 @@ u64 read(const u64 paddr) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
-
-        u64 data;
-        std::memcpy(&data, &pageTable[page][offset], sizeof(u64));
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return read<u64>(paddr);
+    }
 
-        return byteswap(data);
+    if (u64 data; readWatched(paddr, data)) {
+        return data;
     }
 
     if ((paddr >= MemoryBase::PIF_ROM) && (paddr < (MemoryBase::PIF_ROM + MemorySize::PIF_ROM))) {
@@ -262,27 +622,66 @@ u64 read(const u64 paddr) {
     exit(0);
 }
 
+[[gnu::cold, gnu::noinline]] u32 fetchSlow(const u64 paddr) {
+    if (isValidPhysicalAddress(paddr)) {
+        const u64 page = addressToPage(paddr);
+
+        if (materializeLazyPage(page)) {
+            return fetch(paddr);
+        }
+
+        if (const auto it = watchedPages.find(page); (it != watchedPages.end()) && (it->second != NULL)) {
+            watchpoint::check(paddr, sizeof(u32), watchpoint::AccessType::Execute);
+
+            u32 data;
+            std::memcpy(&data, &it->second[paddr & PAGE_MASK], sizeof(u32));
+
+            return byteswap(data);
+        }
+    }
+
+    return readSlow<u32>(paddr);
+}
+
 u32 readIO(const u64 ioaddr) {
     const u64 iopage = addressToIOPage(ioaddr);
 
     switch (iopage) {
         case addressToIOPage(hw::ri::RDRAMRegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::RDRAM]++;
+
             return hw::ri::readRDRAM(ioaddr);
         case addressToIOPage(hw::sp::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::SP]++;
+
             return hw::sp::readIO(ioaddr);
         case addressToIOPage(hw::dp::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::DP]++;
+
             return hw::dp::readIO(ioaddr);
         case addressToIOPage(hw::mi::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::MI]++;
+
             return hw::mi::readIO(ioaddr);
         case addressToIOPage(hw::vi::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::VI]++;
+
             return hw::vi::readIO(ioaddr);
         case addressToIOPage(hw::ai::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::AI]++;
+
             return hw::ai::readIO(ioaddr);
         case addressToIOPage(hw::pi::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::PI]++;
+
             return hw::pi::readIO(ioaddr);
         case addressToIOPage(hw::ri::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::RI]++;
+
             return hw::ri::readIO(ioaddr);
         case addressToIOPage(hw::si::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::SI]++;
+
             return hw::si::readIO(ioaddr);
         default:
             PLOG_FATAL << "Unrecognized IO read (address = " << std::hex << ioaddr << ")";
@@ -292,7 +691,7 @@ u32 readIO(const u64 ioaddr) {
 }
 
 template<>
-void write(const u64 paddr, const u8 data) {
+[[gnu::cold, gnu::noinline]] void writeSlow(const u64 paddr, const u8 data) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -301,11 +700,12 @@ void write(const u64 paddr, const u8 data) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
-
-        pageTable[page][offset] = data;
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return write(paddr, data);
+    }
 
+    if (writeWatched(paddr, data)) {
         return;
     }
 
@@ -315,7 +715,7 @@ void write(const u64 paddr, const u8 data) {
 }
 
 template<>
-void write(const u64 paddr, const u16 data) {
+[[gnu::cold, gnu::noinline]] void writeSlow(const u64 paddr, const u16 data) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -324,11 +724,12 @@ void write(const u64 paddr, const u16 data) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
-        const u16 swappedData = byteswap(data);
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return write(paddr, data);
+    }
 
-        std::memcpy(&pageTable[page][offset], &swappedData, sizeof(u16));
+    if (writeWatched(paddr, data)) {
         return;
     }
 
@@ -338,7 +739,7 @@ void write(const u64 paddr, const u16 data) {
 }
 
 template<>
-void write(const u64 paddr, const u32 data) {
+[[gnu::cold, gnu::noinline]] void writeSlow(const u64 paddr, const u32 data) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -347,11 +748,12 @@ void write(const u64 paddr, const u32 data) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
-        const u32 swappedData = byteswap(data);
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return write(paddr, data);
+    }
 
-        std::memcpy(&pageTable[page][offset], &swappedData, sizeof(u32));
+    if (writeWatched(paddr, data)) {
         return;
     }
 
@@ -359,12 +761,16 @@ void write(const u64 paddr, const u32 data) {
         return hw::pif::write(paddr, byteswap(data));
     }
 
+    if ((paddr >= MemoryBase::CART_DOM2_A2) && (paddr < MemoryBase::CART_DOM1_A2)) {
+        return hw::cart::write(paddr, data);
+    }
+
     // Try to write I/O
     return writeIO(paddr, data);
 }
 
 template<>
-void write(const u64 paddr, const u64 data) {
+[[gnu::cold, gnu::noinline]] void writeSlow(const u64 paddr, const u64 data) {
     if (!isValidPhysicalAddress(paddr)) {
         PLOG_FATAL << "Invalid physical address " << std::hex << paddr;
 
@@ -373,11 +779,12 @@ void write(const u64 paddr, const u64 data) {
 
     const u64 page = addressToPage(paddr);
 
-    if (pageTable[page] != NULL) {
-        const u64 offset = paddr & PAGE_MASK;
-        const u64 swappedData = byteswap(data);
+    // RDRAM pages with a pending lazy DMA are unmapped until first access
+    if (materializeLazyPage(page)) {
+        return write(paddr, data);
+    }
 
-        std::memcpy(&pageTable[page][offset], &swappedData, sizeof(u64));
+    if (writeWatched(paddr, data)) {
         return;
     }
 
@@ -391,26 +798,44 @@ void writeIO(const u64 ioaddr, const u32 data) {
 
     switch (iopage) {
         case addressToIOPage(hw::ri::RDRAMRegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::RDRAM]++;
+
             if (ioaddr >= hw::ri::RDRAMRegister::IOBaseBroadcast) {
                 return hw::ri::writeRDRAMBroadcast(ioaddr, data);
             }
 
             return hw::ri::writeRDRAM(ioaddr, data);
         case addressToIOPage(hw::sp::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::SP]++;
+
             return hw::sp::writeIO(ioaddr, data);
         case addressToIOPage(hw::dp::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::DP]++;
+
             return hw::dp::writeIO(ioaddr, data);
         case addressToIOPage(hw::mi::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::MI]++;
+
             return hw::mi::writeIO(ioaddr, data);
         case addressToIOPage(hw::vi::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::VI]++;
+
             return hw::vi::writeIO(ioaddr, data);
         case addressToIOPage(hw::ai::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::AI]++;
+
             return hw::ai::writeIO(ioaddr, data);
         case addressToIOPage(hw::pi::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::PI]++;
+
             return hw::pi::writeIO(ioaddr, data);
         case addressToIOPage(hw::ri::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::RI]++;
+
             return hw::ri::writeIO(ioaddr, data);
         case addressToIOPage(hw::si::IORegister::IOBase):
+            stats::counters.ioAccesses[stats::IODevice::SI]++;
+
             return hw::si::writeIO(ioaddr, data);
         default:
             PLOG_FATAL << "Unrecognized IO write (address = " << std::hex << ioaddr << ", data = " << data << ")";
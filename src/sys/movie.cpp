@@ -0,0 +1,278 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/movie.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <plog/Log.h>
+
+#include "hw/cart.hpp"
+#include "hw/cpu/hle.hpp"
+#include "hw/pif/joybus.hpp"
+#include "hw/pif/pak.hpp"
+#include "hw/pif/pif.hpp"
+
+#include "sys/emulator.hpp"
+#include "sys/memory.hpp"
+#include "sys/savefile.hpp"
+
+namespace sys::movie {
+
+// "S64M"
+constexpr u32 MAGIC = 0x5336344D;
+constexpr u32 VERSION = 3;
+
+constexpr u64 ADDR_ROM_CHECKSUM = memory::MemoryBase::CART_DOM1_A2 + 0x10;
+
+// Options that change timing, playback has to use the same ones
+namespace OptionFlag {
+    enum : u32 {
+        FastBoot = 1 << 0,
+        HLEPIF = 1 << 1,
+        HLELibultra = 1 << 2,
+    };
+}
+
+enum class MovieMode {
+    None,
+    Record,
+    Playback,
+};
+
+struct Header {
+    u32 magic;
+    u32 version;
+    u32 romChecksum[2];
+
+    // Everything besides input that changes what the game sees, checked on playback
+    u32 optionFlags;
+    u32 controllerNum;
+    u32 pakType;
+    u32 saveType;
+    u64 saveDataHash;
+
+    u64 pollNum;
+};
+
+MovieMode mode = MovieMode::None;
+
+std::string moviePath;
+
+// One button state per controller poll
+std::vector<u32> polls;
+
+// Taken at power-on, before the game had a chance to write its save data
+Header recordHeader;
+
+// Index of the next poll. Part of save states so rewind/run-ahead/state loads stay in sync
+u64 pollIdx;
+
+Header makeHeader() {
+    // Zeroes the padding too, the header is written as-is
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.romChecksum[0] = memory::read<u32>(ADDR_ROM_CHECKSUM + 0);
+    header.romChecksum[1] = memory::read<u32>(ADDR_ROM_CHECKSUM + 4);
+    header.optionFlags = 0;
+    header.controllerNum = hw::pif::joybus::getControllerNum();
+    header.pakType = (u32)hw::pif::pak::getPakType();
+    header.saveType = (u32)hw::cart::getSaveType();
+    header.saveDataHash = savefile::hashData();
+    header.pollNum = polls.size();
+
+    if (emulator::usesFastBoot()) {
+        header.optionFlags |= OptionFlag::FastBoot;
+    }
+
+    if (hw::pif::isHLE()) {
+        header.optionFlags |= OptionFlag::HLEPIF;
+    }
+
+    if (hw::cpu::hle::isEnabled()) {
+        header.optionFlags |= OptionFlag::HLELibultra;
+    }
+
+    return header;
+}
+
+// Writes the recording. Also runs at exit, so fatal errors don't lose it
+void save() {
+    if (mode != MovieMode::Record) {
+        return;
+    }
+
+    mode = MovieMode::None;
+
+    FILE *file = std::fopen(moviePath.c_str(), "wb");
+    if (file == NULL) {
+        PLOG_ERROR << "Unable to open movie file " << moviePath;
+
+        return;
+    }
+
+    Header header = recordHeader;
+    header.pollNum = polls.size();
+
+    std::fwrite(&header, sizeof(Header), 1, file);
+    std::fwrite(polls.data(), sizeof(u32), polls.size(), file);
+    std::fclose(file);
+
+    PLOG_INFO << "Saved movie to " << moviePath << " (" << polls.size() << " polls)";
+}
+
+void init() {}
+
+void deinit() {
+    save();
+}
+
+void reset() {
+    pollIdx = 0;
+}
+
+void doSavestate(savestate::State &state) {
+    state.doPOD(pollIdx);
+}
+
+void startRecording(const char *path) {
+    moviePath = path;
+
+    polls.clear();
+
+    recordHeader = makeHeader();
+
+    mode = MovieMode::Record;
+
+    static bool isAtExitRegistered = false;
+
+    if (!isAtExitRegistered) {
+        std::atexit(save);
+
+        isAtExitRegistered = true;
+    }
+
+    PLOG_INFO << "Recording movie to " << moviePath;
+}
+
+void startPlayback(const char *path) {
+    FILE *file = std::fopen(path, "rb");
+    if (file == NULL) {
+        PLOG_FATAL << "Unable to open movie file " << path;
+
+        exit(0);
+    }
+
+    Header header;
+    if (std::fread(&header, sizeof(Header), 1, file) != 1) {
+        PLOG_FATAL << "Unable to read movie file " << path;
+
+        exit(0);
+    }
+
+    const Header expectedHeader = makeHeader();
+
+    if ((header.magic != expectedHeader.magic) || (header.version != expectedHeader.version)) {
+        PLOG_FATAL << "Incompatible movie (version = " << header.version << ", expected = " << VERSION << ")";
+
+        exit(0);
+    }
+
+    if ((header.romChecksum[0] != expectedHeader.romChecksum[0]) || (header.romChecksum[1] != expectedHeader.romChecksum[1])) {
+        PLOG_FATAL << "Movie was recorded with a different ROM";
+
+        exit(0);
+    }
+
+    if (header.optionFlags != expectedHeader.optionFlags) {
+        const auto getOptions = [](const u32 optionFlags) {
+            std::string options;
+            options += ((optionFlags & OptionFlag::FastBoot) != 0) ? "fast boot" : "boot ROM";
+            options += ((optionFlags & OptionFlag::HLEPIF) != 0) ? ", HLE PIF-NUS" : ", PIF-NUS ROM";
+            options += ((optionFlags & OptionFlag::HLELibultra) != 0) ? ", HLE libultra" : ", no HLE libultra";
+
+            return options;
+        };
+
+        PLOG_FATAL << "Movie was recorded with " << getOptions(header.optionFlags) << ", not " << getOptions(expectedHeader.optionFlags);
+
+        exit(0);
+    }
+
+    if (header.controllerNum != expectedHeader.controllerNum) {
+        PLOG_FATAL << "Movie was recorded with --controllers " << header.controllerNum << ", not " << expectedHeader.controllerNum;
+
+        exit(0);
+    }
+
+    if (header.pakType != expectedHeader.pakType) {
+        PLOG_FATAL << "Movie was recorded with --pak " << hw::pif::pak::getPakTypeName((hw::pif::pak::PakType)header.pakType)
+                   << ", not " << hw::pif::pak::getPakTypeName((hw::pif::pak::PakType)expectedHeader.pakType);
+
+        exit(0);
+    }
+
+    if (header.saveType != expectedHeader.saveType) {
+        PLOG_FATAL << "Movie was recorded with --save-type " << hw::cart::getSaveTypeName((hw::cart::SaveType)header.saveType)
+                   << ", not " << hw::cart::getSaveTypeName((hw::cart::SaveType)expectedHeader.saveType);
+
+        exit(0);
+    }
+
+    if (header.saveDataHash != expectedHeader.saveDataHash) {
+        PLOG_FATAL << "Save data differs from when the movie was recorded, restore the save files it started with";
+
+        exit(0);
+    }
+
+    polls.resize(header.pollNum);
+
+    const bool isRead = std::fread(polls.data(), sizeof(u32), polls.size(), file) == polls.size();
+
+    std::fclose(file);
+
+    if (!isRead) {
+        PLOG_FATAL << "Truncated movie file " << path;
+
+        exit(0);
+    }
+
+    mode = MovieMode::Playback;
+
+    PLOG_INFO << "Playing back movie " << path << " (" << polls.size() << " polls)";
+}
+
+u32 pollController(const u32 buttonState) {
+    switch (mode) {
+        case MovieMode::Record:
+            // Going back in time drops everything recorded after that point
+            polls.resize(pollIdx);
+            polls.push_back(buttonState);
+
+            pollIdx++;
+
+            return buttonState;
+        case MovieMode::Playback:
+            if (pollIdx < polls.size()) {
+                return polls[pollIdx++];
+            }
+
+            if (pollIdx++ == polls.size()) {
+                PLOG_INFO << "Movie playback finished";
+            }
+
+            return buttonState;
+        case MovieMode::None:
+        default:
+            return buttonState;
+    }
+}
+
+}
@@ -0,0 +1,455 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/perf.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <plog/Log.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace sys::perf {
+
+namespace Counter {
+    enum : u32 {
+        Cycles,
+        Instructions,
+        BranchMisses,
+        L1DMisses,
+        LLCMisses,
+        NumberOfCounters,
+    };
+}
+
+constexpr const char *PHASE_NAMES[Phase::NumberOfPhases] = {
+    "Other", "CPU", "RSP", "PIF", "Scheduler", "RDP", "Present",
+};
+
+constexpr const char *COUNTER_NAMES[Counter::NumberOfCounters] = {
+    "cycles", "instructions", "branch misses", "L1D misses", "LLC misses",
+};
+
+constexpr u64 MAX_PHASE_DEPTH = 16;
+
+using Values = u64[Counter::NumberOfCounters];
+
+using Clock = std::chrono::steady_clock;
+
+bool isEnabled = false;
+bool isActive = false;
+
+bool isCounting = false;
+bool isTiming = false;
+
+// Group leader (cycles) and the order counters show up in group reads
+int leaderFD = -1;
+std::vector<int> fds;
+std::vector<u32> openCounters;
+
+bool isCounterOpen[Counter::NumberOfCounters];
+
+Values lastValues;
+Values totals[Phase::NumberOfPhases];
+
+// Time the group was enabled and actually on the PMU, differs if the kernel multiplexed it
+u64 lastTimeEnabled, lastTimeRunning;
+u64 totalTimeEnabled, totalTimeRunning;
+
+u64 phaseEntries[Phase::NumberOfPhases];
+
+Clock::time_point lastTime;
+Clock::duration frameTimes[Phase::NumberOfPhases];
+
+u32 phaseStack[MAX_PHASE_DEPTH];
+u64 phaseDepth;
+
+void setEnabled(const bool isEnabled) {
+    perf::isEnabled = isEnabled;
+}
+
+void setTimingEnabled(const bool isEnabled) {
+    if (isEnabled && !isTiming) {
+        lastTime = Clock::now();
+
+        for (Clock::duration &frameTime : frameTimes) {
+            frameTime = Clock::duration::zero();
+        }
+    }
+
+    isTiming = isEnabled;
+    isActive = isCounting || isTiming;
+}
+
+#ifdef __linux__
+struct CounterConfig {
+    u32 type;
+    u64 config;
+};
+
+constexpr CounterConfig COUNTER_CONFIGS[Counter::NumberOfCounters] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+};
+
+int openCounter(const u32 counter, const int groupFD) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = COUNTER_CONFIGS[counter].type;
+    attr.config = COUNTER_CONFIGS[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // Only the emulator's own user-space work, which also works with perf_event_paranoid = 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // The whole group is started at once
+    attr.disabled = groupFD == -1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, groupFD, 0);
+}
+
+#ifdef __x86_64__
+// Counter pages mapped by the kernel, in openCounters order
+std::vector<perf_event_mmap_page *> pages;
+
+u64 pageSize;
+
+void mapCounterPage(const int fd) {
+    void *page = mmap(NULL, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+
+    pages.push_back((page == MAP_FAILED) ? NULL : (perf_event_mmap_page *)page);
+}
+
+void unmapCounterPages() {
+    for (perf_event_mmap_page *page : pages) {
+        if (page != NULL) {
+            munmap(page, pageSize);
+        }
+    }
+
+    pages.clear();
+}
+
+// Reads the counters with rdpmc, see the seqlock protocol in linux/perf_event.h.
+// Returns false if user-space reads aren't allowed right now
+bool readMappedCounters(Values &values, u64 &timeEnabled, u64 &timeRunning) {
+    for (u64 i = 0; i < pages.size(); i++) {
+        const perf_event_mmap_page *page = pages[i];
+
+        if (page == NULL) {
+            return false;
+        }
+
+        u32 seq, index;
+        u64 count, enabled, running, cycles = 0;
+
+        do {
+            seq = page->lock;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+
+            // Without rdpmc the index reads as 0 and the offset goes stale
+            if (!page->cap_user_rdpmc) {
+                return false;
+            }
+
+            index = page->index;
+
+            count = page->offset;
+            enabled = page->time_enabled;
+            running = page->time_running;
+
+            if (index != 0) {
+                const u32 width = page->pmc_width;
+
+                count += (u64)(((i64)__rdpmc(index - 1) << (64 - width)) >> (64 - width));
+            }
+
+            if (page->cap_user_time) {
+                cycles = __rdtsc();
+
+                // Time since the kernel last updated the page
+                const u64 quot = cycles >> page->time_shift;
+                const u64 rem = cycles & ((1ULL << page->time_shift) - 1);
+                const u64 delta = page->time_offset + (quot * page->time_mult) + ((rem * page->time_mult) >> page->time_shift);
+
+                enabled += delta;
+
+                if (index != 0) {
+                    running += delta;
+                }
+            }
+
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } while (page->lock != seq);
+
+        values[openCounters[i]] = count;
+
+        // Counters in a group are scheduled together, so the leader's times hold for all of them
+        if (i == 0) {
+            timeEnabled = enabled;
+            timeRunning = running;
+        }
+    }
+
+    return true;
+}
+#endif
+
+// Reads every open counter, from user space if possible, otherwise with a single syscall
+bool readCounters(Values &values, u64 &timeEnabled, u64 &timeRunning) {
+#ifdef __x86_64__
+    if (readMappedCounters(values, timeEnabled, timeRunning)) {
+        return true;
+    }
+#endif
+
+    u64 buffer[3 + Counter::NumberOfCounters];
+
+    if (read(leaderFD, buffer, sizeof(buffer)) <= 0) {
+        return false;
+    }
+
+    timeEnabled = buffer[1];
+    timeRunning = buffer[2];
+
+    for (u64 i = 0; (i < buffer[0]) && (i < openCounters.size()); i++) {
+        values[openCounters[i]] = buffer[3 + i];
+    }
+
+    return true;
+}
+#endif
+
+// Adds everything counted since the last sample to the current phase
+void sample() {
+    const u32 phase = (phaseDepth > 0) ? phaseStack[phaseDepth - 1] : Phase::Other;
+
+    if (isTiming) {
+        const Clock::time_point now = Clock::now();
+
+        frameTimes[phase] += now - lastTime;
+
+        lastTime = now;
+    }
+
+#ifdef __linux__
+    if (isCounting) {
+        Values values;
+        std::memcpy(values, lastValues, sizeof(Values));
+
+        u64 timeEnabled, timeRunning;
+        if (!readCounters(values, timeEnabled, timeRunning)) {
+            return;
+        }
+
+        const u64 deltaEnabled = timeEnabled - lastTimeEnabled;
+        const u64 deltaRunning = timeRunning - lastTimeRunning;
+
+        totalTimeEnabled += deltaEnabled;
+        totalTimeRunning += deltaRunning;
+
+        // Extrapolate to the whole interval if the group was only on the PMU for part of it
+        const bool isScaled = (deltaRunning > 0) && (deltaRunning < deltaEnabled);
+
+        for (u32 counter = 0; counter < Counter::NumberOfCounters; counter++) {
+            const u64 delta = values[counter] - lastValues[counter];
+
+            totals[phase][counter] += isScaled ? (u64)((double)delta * deltaEnabled / deltaRunning) : delta;
+        }
+
+        std::memcpy(lastValues, values, sizeof(Values));
+
+        lastTimeEnabled = timeEnabled;
+        lastTimeRunning = timeRunning;
+    }
+#endif
+}
+
+void takeFrameTimes(double (&times)[Phase::NumberOfPhases]) {
+    if (isTiming) {
+        sample();
+    }
+
+    for (u32 phase = 0; phase < Phase::NumberOfPhases; phase++) {
+        times[phase] = std::chrono::duration<double>(frameTimes[phase]).count();
+
+        frameTimes[phase] = Clock::duration::zero();
+    }
+}
+
+void init() {
+    std::memset(isCounterOpen, 0, sizeof(isCounterOpen));
+    std::memset(lastValues, 0, sizeof(lastValues));
+    std::memset(totals, 0, sizeof(totals));
+    std::memset(phaseEntries, 0, sizeof(phaseEntries));
+
+    lastTimeEnabled = lastTimeRunning = 0;
+    totalTimeEnabled = totalTimeRunning = 0;
+
+    phaseDepth = 0;
+
+    if (!isEnabled) {
+        return;
+    }
+
+#ifdef __linux__
+    for (u32 counter = 0; counter < Counter::NumberOfCounters; counter++) {
+        const int fd = openCounter(counter, leaderFD);
+
+        if (fd == -1) {
+            // Everything else is reported relative to cycles
+            if (counter == Counter::Cycles) {
+                PLOG_WARNING << "Unable to open host cycle counter, check perf_event_paranoid";
+
+                return;
+            }
+
+            PLOG_WARNING << "Host counter " << COUNTER_NAMES[counter] << " is unavailable";
+
+            continue;
+        }
+
+        if (leaderFD == -1) {
+            leaderFD = fd;
+        }
+
+        fds.push_back(fd);
+        openCounters.push_back(counter);
+
+        isCounterOpen[counter] = true;
+    }
+
+#ifdef __x86_64__
+    // Phases change several times per slice, rdpmc keeps the syscalls out of the measurements
+    pageSize = sysconf(_SC_PAGESIZE);
+
+    for (const int fd : fds) {
+        mapCounterPage(fd);
+    }
+#endif
+
+    ioctl(leaderFD, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leaderFD, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    readCounters(lastValues, lastTimeEnabled, lastTimeRunning);
+
+    isCounting = true;
+    isActive = true;
+#else
+    PLOG_WARNING << "Host counters are only supported on Linux";
+#endif
+}
+
+void printReport() {
+    u64 allCycles = 0;
+    for (const Values &values : totals) {
+        allCycles += values[Counter::Cycles];
+    }
+
+    std::printf("Host counters per phase:\n");
+
+    if (totalTimeRunning < totalTimeEnabled) {
+        std::printf("Counters were multiplexed (on the PMU %.1f%% of the time), counts are scaled estimates\n", 100.0 * totalTimeRunning / totalTimeEnabled);
+    }
+    std::printf("%-10s %8s %16s %6s %12s %12s %12s %12s\n", "Phase", "Entries", "Cycles", "IPC", "Cycles %", "BrMiss/1k", "L1DMiss/1k", "LLCMiss/1k");
+
+    for (u32 phase = 0; phase < Phase::NumberOfPhases; phase++) {
+        const Values &values = totals[phase];
+
+        const u64 cycles = values[Counter::Cycles];
+        const u64 instructions = values[Counter::Instructions];
+
+        if (cycles == 0) {
+            continue;
+        }
+
+        const double ipc = isCounterOpen[Counter::Instructions] ? ((double)instructions / cycles) : 0.0;
+
+        // Misses per 1000 host instructions
+        const auto getMissRate = [&](const u32 counter) {
+            return (isCounterOpen[counter] && (instructions > 0)) ? (1000.0 * values[counter] / instructions) : 0.0;
+        };
+
+        std::printf(
+            "%-10s %8" PRIu64 " %16" PRIu64 " %6.2f %11.1f%% %12.2f %12.2f %12.2f\n",
+            PHASE_NAMES[phase], phaseEntries[phase], cycles, ipc, 100.0 * cycles / allCycles,
+            getMissRate(Counter::BranchMisses), getMissRate(Counter::L1DMisses), getMissRate(Counter::LLCMisses)
+        );
+    }
+}
+
+void deinit() {
+    if (!isCounting) {
+        return;
+    }
+
+    // Whatever ran since the last phase change
+    sample();
+
+    isCounting = false;
+    isActive = isTiming;
+
+    printReport();
+
+#ifdef __linux__
+#ifdef __x86_64__
+    unmapCounterPages();
+#endif
+
+    for (const int fd : fds) {
+        close(fd);
+    }
+#endif
+
+    fds.clear();
+    openCounters.clear();
+
+    leaderFD = -1;
+}
+
+void enter(const u32 phase) {
+    if (phaseDepth == MAX_PHASE_DEPTH) {
+        PLOG_FATAL << "Phases nested too deeply";
+
+        exit(0);
+    }
+
+    sample();
+
+    phaseStack[phaseDepth++] = phase;
+    phaseEntries[phase]++;
+}
+
+void leave() {
+    sample();
+
+    if (phaseDepth > 0) {
+        phaseDepth--;
+    }
+}
+
+}
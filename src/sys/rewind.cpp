@@ -0,0 +1,264 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/rewind.hpp"
+
+#include <array>
+#include <cstring>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <plog/Log.h>
+
+#include "sys/memory.hpp"
+#include "sys/savestate.hpp"
+
+namespace sys::rewind {
+
+// Keep up to 20 seconds of history at 60 FPS, bounded by MAX_HISTORY_SIZE
+constexpr u64 MAX_CHECKPOINTS = 20 * 60;
+constexpr u64 MAX_HISTORY_SIZE = 128 << 20;
+
+constexpr u64 WORDS_PER_PAGE = memory::PAGE_SIZE / sizeof(u32);
+
+struct Checkpoint {
+    // Compressed XOR deltas of all RDRAM pages that changed since the previous checkpoint,
+    // each preceded by the page's lazy DMA source at the previous checkpoint
+    std::vector<u8> pageDeltas;
+
+    // Everything but RDRAM, including cartridge and Controller Pak save data
+    std::vector<u8> deviceState;
+
+    u64 getSize() const {
+        return pageDeltas.size() + deviceState.size();
+    }
+};
+
+std::deque<Checkpoint> history;
+
+u64 historySize;
+
+// RDRAM as of the most recent checkpoint
+std::array<u8, memory::MemorySize::RDRAM> shadowRDRAM;
+
+// Pages that were pending lazy copies at the most recent checkpoint. Their shadow data is stale,
+// the contents are read from the lazy source instead, so checkpoints never materialize lazy DMA pages
+std::array<const u8 *, memory::NUM_RDRAM_PAGES> shadowLazySources;
+
+// Dirty tracking cursor, taken when the shadow copy was last brought up to date
+u64 dirtyCursor;
+
+void init() {}
+
+void deinit() {}
+
+void reset() {
+    history.clear();
+
+    historySize = 0;
+
+    for (u64 page = 0; page < memory::NUM_RDRAM_PAGES; page++) {
+        shadowLazySources[page] = memory::getLazySource(page);
+
+        if (shadowLazySources[page] == NULL) {
+            std::memcpy(&shadowRDRAM[memory::pageToAddress(page)], memory::getPageContents(page), memory::PAGE_SIZE);
+        }
+    }
+
+    dirtyCursor = memory::advanceGeneration();
+}
+
+u32 loadWord(const u8 *data) {
+    u32 word;
+    std::memcpy(&word, data, sizeof(u32));
+
+    return word;
+}
+
+void storeWord(u8 *data, const u32 word) {
+    std::memcpy(data, &word, sizeof(u32));
+}
+
+template<typename T>
+void append(std::vector<u8> &buffer, const T data) {
+    const u8 *bytes = (const u8 *)&data;
+
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+// Appends the XOR of two pages as a list of (zero run, literal run, literals...) tokens
+void compressPage(std::vector<u8> &buffer, const u8 *newPage, const u8 *oldPage) {
+    u64 i = 0;
+    while (i < WORDS_PER_PAGE) {
+        const u64 zeroStart = i;
+        while ((i < WORDS_PER_PAGE) && (loadWord(&newPage[4 * i]) == loadWord(&oldPage[4 * i]))) {
+            i++;
+        }
+
+        const u64 literalStart = i;
+        while ((i < WORDS_PER_PAGE) && (loadWord(&newPage[4 * i]) != loadWord(&oldPage[4 * i]))) {
+            i++;
+        }
+
+        append(buffer, (u16)(literalStart - zeroStart));
+        append(buffer, (u16)(i - literalStart));
+
+        for (u64 j = literalStart; j < i; j++) {
+            append(buffer, loadWord(&newPage[4 * j]) ^ loadWord(&oldPage[4 * j]));
+        }
+    }
+}
+
+// XORs a compressed page delta into page, returns the number of bytes consumed
+u64 decompressPage(u8 *page, const u8 *data) {
+    u64 offset = 0;
+
+    u64 i = 0;
+    while (i < WORDS_PER_PAGE) {
+        u16 zeroRun, literalRun;
+        std::memcpy(&zeroRun, &data[offset + 0], sizeof(u16));
+        std::memcpy(&literalRun, &data[offset + 2], sizeof(u16));
+
+        offset += 2 * sizeof(u16);
+
+        i += zeroRun;
+
+        for (u64 j = 0; j < literalRun; j++, i++) {
+            storeWord(&page[4 * i], loadWord(&page[4 * i]) ^ loadWord(&data[offset]));
+
+            offset += sizeof(u32);
+        }
+    }
+
+    return offset;
+}
+
+// Returns the contents of a page as of the most recent checkpoint
+const u8 *getShadowContents(const u64 page) {
+    if (shadowLazySources[page] != NULL) {
+        return shadowLazySources[page];
+    }
+
+    return &shadowRDRAM[memory::pageToAddress(page)];
+}
+
+void pushCheckpoint() {
+    Checkpoint checkpoint;
+
+    // Drop the oldest checkpoints, recycling their buffers
+    while (!history.empty() && ((history.size() >= MAX_CHECKPOINTS) || (historySize >= MAX_HISTORY_SIZE))) {
+        historySize -= history.front().getSize();
+
+        checkpoint = std::move(history.front());
+
+        history.pop_front();
+    }
+
+    checkpoint.pageDeltas.clear();
+
+    // Only store pages that changed, then bring the shadow copy up to date
+    for (u64 page = 0; page < memory::NUM_RDRAM_PAGES; page++) {
+        if (!memory::isPageDirty(page, dirtyCursor)) {
+            continue;
+        }
+
+        const u64 offset = memory::pageToAddress(page);
+
+        const u8 *newPage = memory::getPageContents(page);
+        const u8 *oldPage = getShadowContents(page);
+
+        // Pages can be written without actually changing
+        if (std::memcmp(newPage, oldPage, memory::PAGE_SIZE) == 0) {
+            continue;
+        }
+
+        append(checkpoint.pageDeltas, (u32)page);
+        append(checkpoint.pageDeltas, shadowLazySources[page]);
+
+        compressPage(checkpoint.pageDeltas, newPage, oldPage);
+
+        // Lazy pages only remember their source
+        shadowLazySources[page] = memory::getLazySource(page);
+
+        if (shadowLazySources[page] == NULL) {
+            std::memcpy(&shadowRDRAM[offset], newPage, memory::PAGE_SIZE);
+        }
+    }
+
+    dirtyCursor = memory::advanceGeneration();
+
+    savestate::saveToBuffer(checkpoint.deviceState, savestate::StateFlag::SaveData);
+
+    historySize += checkpoint.getSize();
+
+    history.push_back(std::move(checkpoint));
+}
+
+bool popCheckpoint() {
+    if (history.empty()) {
+        return false;
+    }
+
+    Checkpoint &checkpoint = history.back();
+
+    // The shadow copy holds RDRAM as of this checkpoint, only pages written since then differ
+    u8 *rdram = memory::getPointer(memory::MemoryBase::RDRAM);
+
+    for (u64 page = 0; page < memory::NUM_RDRAM_PAGES; page++) {
+        if (memory::isPageDirty(page, dirtyCursor)) {
+            const u64 offset = memory::pageToAddress(page);
+
+            // Pages that were lazy at the checkpoint become lazy again instead of being copied
+            memory::setLazyPage(page, shadowLazySources[page]);
+
+            if (shadowLazySources[page] == NULL) {
+                std::memcpy(&rdram[offset], &shadowRDRAM[offset], memory::PAGE_SIZE);
+            }
+
+            memory::markDirty(offset, memory::PAGE_SIZE);
+        }
+    }
+
+    if (!savestate::loadFromBuffer(checkpoint.deviceState, savestate::StateFlag::SaveData)) {
+        PLOG_ERROR << "Failed to restore rewind checkpoint";
+    }
+
+    dirtyCursor = memory::advanceGeneration();
+
+    // Undo this checkpoint's deltas, the shadow copy now matches the previous checkpoint.
+    // RDRAM no longer matches the shadow copy in those pages, mark them so the next checkpoint picks them up
+    for (u64 offset = 0; offset < checkpoint.pageDeltas.size();) {
+        const u64 page = loadWord(&checkpoint.pageDeltas[offset]);
+
+        offset += sizeof(u32);
+
+        const u8 *oldLazySource;
+        std::memcpy(&oldLazySource, &checkpoint.pageDeltas[offset], sizeof(oldLazySource));
+
+        offset += sizeof(oldLazySource);
+
+        // Deltas apply to the page contents, which only live in the lazy source for lazy pages
+        u8 *shadowPage = &shadowRDRAM[memory::pageToAddress(page)];
+
+        if (shadowLazySources[page] != NULL) {
+            std::memcpy(shadowPage, shadowLazySources[page], memory::PAGE_SIZE);
+        }
+
+        offset += decompressPage(shadowPage, &checkpoint.pageDeltas[offset]);
+
+        shadowLazySources[page] = oldLazySource;
+
+        memory::markDirty(memory::pageToAddress(page), memory::PAGE_SIZE);
+    }
+
+    historySize -= checkpoint.getSize();
+
+    history.pop_back();
+
+    return true;
+}
+
+}
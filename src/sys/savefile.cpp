@@ -0,0 +1,295 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/savefile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <plog/Log.h>
+
+namespace sys::savefile {
+
+using Clock = std::chrono::steady_clock;
+
+// Dirty pages are written back once they haven't been touched for this long
+constexpr auto QUIET_PERIOD = std::chrono::milliseconds(1000);
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(250);
+
+// One bit per host page
+constexpr u64 MAX_PAGES = 64;
+
+struct SaveFile {
+    std::string path;
+
+    int fd;
+
+    u8 *data;
+    u64 size;
+
+    // Shared with the flusher thread
+    std::atomic<u64> dirtyPages;
+    std::atomic<Clock::rep> lastWriteTime;
+};
+
+std::vector<std::unique_ptr<SaveFile>> files;
+
+u64 hostPageSize;
+
+std::thread flusher;
+std::mutex flusherMutex;
+std::condition_variable flusherCondition;
+
+bool isFlusherRunning;
+
+// Loaded save data is compared against the file before it's written back
+std::vector<u8> loadBuffer;
+
+// Writes dirty pages back to disk
+void flush(SaveFile &file) {
+    u64 pages = file.dirtyPages.exchange(0);
+
+    while (pages != 0) {
+        // Sync runs of consecutive dirty pages with one call
+        const u64 firstPage = std::countr_zero(pages);
+
+        u64 lastPage = firstPage;
+        while ((lastPage < (MAX_PAGES - 1)) && ((pages & (1ULL << (lastPage + 1))) != 0)) {
+            lastPage++;
+        }
+
+        const u64 offset = firstPage * hostPageSize;
+        const u64 size = std::min((lastPage + 1) * hostPageSize, file.size) - offset;
+
+        if (msync(&file.data[offset], size, MS_SYNC) != 0) {
+            PLOG_ERROR << "Unable to write back save file " << file.path;
+        }
+
+        for (u64 page = firstPage; page <= lastPage; page++) {
+            pages &= ~(1ULL << page);
+        }
+    }
+}
+
+void unmap(SaveFile &file) {
+    flush(file);
+
+    munmap(file.data, file.size);
+    ::close(file.fd);
+}
+
+void runFlusher() {
+    std::unique_lock lock(flusherMutex);
+
+    while (isFlusherRunning) {
+        flusherCondition.wait_for(lock, POLL_INTERVAL);
+
+        const auto now = Clock::now().time_since_epoch().count();
+
+        for (auto &file : files) {
+            if (file->dirtyPages.load() == 0) {
+                continue;
+            }
+
+            if ((now - file->lastWriteTime.load()) >= Clock::duration(QUIET_PERIOD).count()) {
+                flush(*file);
+            }
+        }
+    }
+}
+
+void init() {
+    hostPageSize = sysconf(_SC_PAGESIZE);
+
+    isFlusherRunning = true;
+
+    flusher = std::thread(runFlusher);
+}
+
+void deinit() {
+    {
+        std::lock_guard lock(flusherMutex);
+
+        isFlusherRunning = false;
+    }
+
+    flusherCondition.notify_one();
+
+    flusher.join();
+
+    // Files their owners didn't close
+    for (auto &file : files) {
+        unmap(*file);
+    }
+
+    files.clear();
+}
+
+void reset() {}
+
+SaveFile *open(const char *path, const u64 size, const u8 fill) {
+    if (((size + hostPageSize - 1) / hostPageSize) > MAX_PAGES) {
+        PLOG_FATAL << "Save file " << path << " is too large";
+
+        exit(0);
+    }
+
+    const int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        PLOG_FATAL << "Unable to open save file " << path;
+
+        exit(0);
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        PLOG_FATAL << "Unable to get size of save file " << path;
+
+        exit(0);
+    }
+
+    const u64 oldSize = fileStat.st_size;
+
+    if ((oldSize < size) && (ftruncate(fd, size) != 0)) {
+        PLOG_FATAL << "Unable to resize save file " << path;
+
+        exit(0);
+    }
+
+    u8 *data = (u8 *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        PLOG_FATAL << "Unable to map save file " << path;
+
+        exit(0);
+    }
+
+    std::unique_ptr<SaveFile> file = std::make_unique<SaveFile>();
+    file->path = path;
+    file->fd = fd;
+    file->data = data;
+    file->size = size;
+    file->dirtyPages = 0;
+    file->lastWriteTime = 0;
+
+    // New save files start out erased
+    if (oldSize < size) {
+        std::memset(&data[oldSize], fill, size - oldSize);
+
+        markDirty(file.get(), oldSize, size - oldSize);
+    }
+
+    PLOG_INFO << "Save file path = " << path << " (" << size << " bytes)";
+
+    std::lock_guard lock(flusherMutex);
+
+    files.push_back(std::move(file));
+
+    return files.back().get();
+}
+
+void close(SaveFile *file) {
+    std::lock_guard lock(flusherMutex);
+
+    const auto it = std::find_if(files.begin(), files.end(), [file](const auto &openFile) { return openFile.get() == file; });
+    if (it == files.end()) {
+        return;
+    }
+
+    unmap(**it);
+
+    files.erase(it);
+}
+
+u8 *getData(SaveFile *file) {
+    return file->data;
+}
+
+u64 hashData() {
+    constexpr u64 FNV_OFFSET_BASIS = 0xCBF29CE484222325;
+    constexpr u64 FNV_PRIME = 0x100000001B3;
+
+    u64 hash = FNV_OFFSET_BASIS;
+
+    std::lock_guard lock(flusherMutex);
+
+    for (const auto &file : files) {
+        for (u64 i = 0; i < file->size; i++) {
+            hash = (hash ^ file->data[i]) * FNV_PRIME;
+        }
+    }
+
+    return hash;
+}
+
+void markDirty(SaveFile *file, const u64 offset, const u64 size) {
+    if ((size == 0) || (offset >= file->size)) {
+        return;
+    }
+
+    const u64 lastOffset = std::min(offset + size, file->size) - 1;
+
+    u64 pages = 0;
+    for (u64 page = offset / hostPageSize; page <= (lastOffset / hostPageSize); page++) {
+        pages |= 1ULL << page;
+    }
+
+    file->lastWriteTime = Clock::now().time_since_epoch().count();
+    file->dirtyPages |= pages;
+}
+
+void doSavestate(sys::savestate::State &state, SaveFile *file) {
+    if (!state.hasFlag(sys::savestate::StateFlag::SaveData)) {
+        return;
+    }
+
+    // A state taken with a different save type has a different size
+    u64 size = (file != NULL) ? file->size : 0;
+    const u64 expectedSize = size;
+
+    state.doPOD(size);
+
+    if (size != expectedSize) {
+        state.invalidate();
+
+        return;
+    }
+
+    if (size == 0) {
+        return;
+    }
+
+    if (!state.isLoading()) {
+        state.doBytes(file->data, size);
+
+        return;
+    }
+
+    loadBuffer.resize(size);
+
+    state.doBytes(loadBuffer.data(), size);
+
+    if (state.isValid() && (std::memcmp(file->data, loadBuffer.data(), size) != 0)) {
+        std::memcpy(file->data, loadBuffer.data(), size);
+
+        markDirty(file, 0, size);
+    }
+}
+
+}
@@ -0,0 +1,255 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/savestate.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <ios>
+
+#include <plog/Log.h>
+
+#include "hw/ai.hpp"
+#include "hw/cart.hpp"
+#include "hw/cic.hpp"
+#include "hw/dp.hpp"
+#include "hw/mi.hpp"
+#include "hw/pi.hpp"
+#include "hw/ri.hpp"
+#include "hw/si.hpp"
+#include "hw/sp.hpp"
+#include "hw/vi.hpp"
+#include "hw/cpu/cpu.hpp"
+#include "hw/pif/joybus.hpp"
+#include "hw/pif/memory.hpp"
+#include "hw/pif/pak.hpp"
+#include "hw/pif/pif.hpp"
+#include "hw/rdp/rasterizer.hpp"
+#include "hw/rsp/rsp.hpp"
+
+#include "sys/audio.hpp"
+#include "sys/emulator.hpp"
+#include "sys/memory.hpp"
+#include "sys/movie.hpp"
+#include "sys/scheduler.hpp"
+
+namespace sys::savestate {
+
+// "S64S"
+constexpr u32 MAGIC = 0x53343653;
+
+// Has to be incremented every time the state layout changes
+constexpr u32 VERSION = 8;
+
+// ROM header checksums, used to reject states from other games
+constexpr u64 ADDR_ROM_CHECKSUM = memory::MemoryBase::CART_DOM1_A2 + 0x10;
+
+struct Header {
+    u32 magic;
+    u32 version;
+    u32 flags;
+    u32 romChecksum[2];
+};
+
+std::vector<u8> fileBuffer, backupBuffer;
+
+State::State(std::vector<u8> &buffer, const u32 flags) : saveBuffer(&buffer), loadData(NULL), loadSize(0), offset(0), flags(flags), isOverrun(false) {}
+
+State::State(const u8 *data, const u64 size, const u32 flags) : saveBuffer(NULL), loadData(data), loadSize(size), offset(0), flags(flags), isOverrun(false) {}
+
+bool State::isLoading() const {
+    return saveBuffer == NULL;
+}
+
+bool State::isValid() const {
+    return !isOverrun;
+}
+
+u64 State::getSize() const {
+    return offset;
+}
+
+void State::invalidate() {
+    isOverrun = true;
+}
+
+bool State::hasFlag(const u32 flag) const {
+    return (flags & flag) != 0;
+}
+
+void State::doBytes(void *data, const u64 size) {
+    if (isLoading()) {
+        if (isOverrun || (size > (loadSize - offset))) {
+            isOverrun = true;
+
+            return;
+        }
+
+        std::memcpy(data, &loadData[offset], size);
+    } else {
+        const u8 *bytes = (const u8 *)data;
+
+        saveBuffer->insert(saveBuffer->end(), bytes, bytes + size);
+    }
+
+    offset += size;
+}
+
+void init() {}
+
+void deinit() {}
+
+void reset() {}
+
+Header makeHeader(const u32 flags) {
+    Header header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.flags = flags;
+    header.romChecksum[0] = memory::read<u32>(ADDR_ROM_CHECKSUM + 0);
+    header.romChecksum[1] = memory::read<u32>(ADDR_ROM_CHECKSUM + 4);
+
+    return header;
+}
+
+// Serializes every component in a fixed order
+void doMachine(State &state) {
+    memory::doSavestate(state);
+    scheduler::doSavestate(state);
+
+    audio::doSavestate(state);
+    emulator::doSavestate(state);
+    movie::doSavestate(state);
+
+    hw::pif::memory::doSavestate(state);
+
+    hw::cpu::doSavestate(state);
+    hw::ai::doSavestate(state);
+    hw::cart::doSavestate(state);
+    hw::cic::doSavestate(state);
+    hw::dp::doSavestate(state);
+    hw::mi::doSavestate(state);
+    hw::pi::doSavestate(state);
+    hw::pif::doSavestate(state);
+    hw::pif::joybus::doSavestate(state);
+    hw::pif::pak::doSavestate(state);
+    hw::rdp::rasterizer::doSavestate(state);
+    hw::rsp::doSavestate(state);
+    hw::ri::doSavestate(state);
+    hw::si::doSavestate(state);
+    hw::sp::doSavestate(state);
+    hw::vi::doSavestate(state);
+}
+
+void saveToBuffer(std::vector<u8> &buffer, const u32 flags) {
+    buffer.clear();
+
+    State state(buffer, flags);
+
+    doMachine(state);
+}
+
+bool loadFromBuffer(const std::vector<u8> &buffer, const u32 flags) {
+    State state(buffer.data(), buffer.size(), flags);
+
+    doMachine(state);
+
+    return state.isValid() && (state.getSize() == buffer.size());
+}
+
+bool save(const char *path) {
+    fileBuffer.clear();
+
+    State state(fileBuffer, StateFlag::All);
+
+    Header header = makeHeader(StateFlag::All);
+
+    state.doPOD(header);
+
+    doMachine(state);
+
+    FILE *file = std::fopen(path, "wb");
+    if (file == NULL) {
+        PLOG_ERROR << "Unable to open save state file " << path;
+
+        return false;
+    }
+
+    const bool isWritten = std::fwrite(fileBuffer.data(), sizeof(u8), fileBuffer.size(), file) == fileBuffer.size();
+
+    std::fclose(file);
+
+    if (!isWritten) {
+        PLOG_ERROR << "Unable to write save state file " << path;
+
+        return false;
+    }
+
+    PLOG_INFO << "Saved state to " << path << " (" << fileBuffer.size() << " bytes)";
+
+    return true;
+}
+
+bool load(const char *path) {
+    FILE *file = std::fopen(path, "rb");
+    if (file == NULL) {
+        PLOG_ERROR << "Unable to open save state file " << path;
+
+        return false;
+    }
+
+    // Get file size
+    std::fseek(file, 0, SEEK_END);
+    fileBuffer.resize(std::ftell(file));
+    std::fseek(file, 0, SEEK_SET);
+
+    const bool isRead = std::fread(fileBuffer.data(), sizeof(u8), fileBuffer.size(), file) == fileBuffer.size();
+
+    std::fclose(file);
+
+    if (!isRead || (fileBuffer.size() < sizeof(Header))) {
+        PLOG_ERROR << "Unable to read save state file " << path;
+
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, fileBuffer.data(), sizeof(Header));
+
+    const Header expectedHeader = makeHeader(StateFlag::All);
+
+    if ((header.magic != expectedHeader.magic) || (header.version != expectedHeader.version)) {
+        PLOG_ERROR << "Incompatible save state (version = " << header.version << ", expected = " << VERSION << ")";
+
+        return false;
+    }
+
+    if ((header.romChecksum[0] != expectedHeader.romChecksum[0]) || (header.romChecksum[1] != expectedHeader.romChecksum[1])) {
+        PLOG_ERROR << "Save state was made with a different ROM";
+
+        return false;
+    }
+
+    // Keep the current state around in case the save state turns out to be truncated
+    saveToBuffer(backupBuffer, StateFlag::All);
+
+    State state(&fileBuffer[sizeof(Header)], fileBuffer.size() - sizeof(Header), header.flags);
+
+    doMachine(state);
+
+    if (!state.isValid() || (state.getSize() != (fileBuffer.size() - sizeof(Header)))) {
+        PLOG_ERROR << "Corrupt save state " << path;
+
+        loadFromBuffer(backupBuffer, StateFlag::All);
+
+        return false;
+    }
+
+    PLOG_INFO << "Loaded state from " << path;
+
+    return true;
+}
+
+}
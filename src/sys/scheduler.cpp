@@ -5,14 +5,19 @@
 
 #include "sys/scheduler.hpp"
 
+#include <algorithm>
 #include <cassert>
-#include <queue>
 #include <vector>
 
+#include "sys/stats.hpp"
+
 namespace sys::scheduler {
 
 constexpr i64 MAX_RUN_CYCLES = 4096;
 
+// Upper bound on pending events, used to reject corrupt save states
+constexpr u64 MAX_EVENTS = 1024;
+
 // Scheduler event
 struct Event {
     u64 id;
@@ -25,10 +30,11 @@ struct Event {
     }
 };
 
-// Event queue
-std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+// Event queue (min-heap), kept as a plain vector so it can be serialized
+std::vector<Event> events;
 
 std::vector<std::function<void(int)>> registeredFuncs;
+std::vector<const char *> registeredNames;
 
 i64 globalTimestamp = 0;
 
@@ -36,22 +42,62 @@ void init() {}
 
 void deinit() {}
 
-void reset() {}
+void reset() {
+    events.clear();
+
+    globalTimestamp = 0;
+}
+
+void doSavestate(savestate::State &state) {
+    u64 size = events.size();
+    state.doPOD(size);
+
+    if (state.isLoading()) {
+        if (size > MAX_EVENTS) {
+            state.invalidate();
+
+            return;
+        }
+
+        events.resize(size);
+    }
+
+    // The heap layout is saved as-is, so no need to rebuild it on load
+    state.doBytes(events.data(), size * sizeof(Event));
+    state.doPOD(globalTimestamp);
+
+    if (state.isLoading()) {
+        // A corrupt ID would index past the registered callbacks
+        for (const Event &event : events) {
+            if (event.id >= registeredFuncs.size()) {
+                state.invalidate();
+
+                return;
+            }
+        }
+    }
+}
 
-// Registers an event, returns event ID
-u64 registerEvent(const std::function<void(int)> func) {
+u64 registerEvent(const char *name, const std::function<void(int)> func) {
     static u64 idPool;
 
     registeredFuncs.push_back(func);
+    registeredNames.push_back(name);
 
     return idPool++;
 }
 
+const char *getEventName(const u64 id) {
+    return registeredNames[id];
+}
+
 // Adds a scheduler event
 void addEvent(const u64 id, const int param, const i64 cyclesUntilEvent) {
     assert(cyclesUntilEvent > 0);
 
-    events.emplace(Event{id, param, globalTimestamp + cyclesUntilEvent});
+    events.emplace_back(Event{id, param, globalTimestamp + cyclesUntilEvent});
+
+    std::push_heap(events.begin(), events.end(), std::greater<Event>());
 }
 
 i64 getRunCycles() {
@@ -61,13 +107,18 @@ i64 getRunCycles() {
 void run(const i64 runCycles) {
     const auto newTimestamp = globalTimestamp + runCycles;
 
-    while (events.top().timestamp <= newTimestamp) {
-        globalTimestamp = events.top().timestamp;
+    while (!events.empty() && (events.front().timestamp <= newTimestamp)) {
+        globalTimestamp = events.front().timestamp;
+
+        const auto id = events.front().id;
+        const auto param = events.front().param;
 
-        const auto id = events.top().id;
-        const auto param = events.top().param;
+        std::pop_heap(events.begin(), events.end(), std::greater<Event>());
+        events.pop_back();
 
-        events.pop();
+        if (id < stats::MAX_EVENT_TYPES) {
+            stats::counters.events[id]++;
+        }
 
         registeredFuncs[id](param);
     }
@@ -0,0 +1,76 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/stats.hpp"
+
+#include <cstring>
+#include <mutex>
+
+namespace sys::stats {
+
+constexpr const char *DMA_ENGINE_NAMES[DMAEngine::NumberOfEngines] = {
+    "AI", "PI", "SI", "SP",
+};
+
+constexpr const char *IO_DEVICE_NAMES[IODevice::NumberOfDevices] = {
+    "RDRAM", "SP", "DP", "MI", "VI", "AI", "PI", "RI", "SI",
+};
+
+thread_local Counters counters;
+
+// Written by the emulation thread once per frame, read by anyone
+std::mutex lastFrameMutex;
+
+Counters lastFrame;
+
+u64 frameNum;
+
+void init() {}
+
+void deinit() {}
+
+void reset() {
+    std::memset(&counters, 0, sizeof(Counters));
+
+    std::lock_guard lock(lastFrameMutex);
+
+    std::memset(&lastFrame, 0, sizeof(Counters));
+
+    frameNum = 0;
+}
+
+void onFrame() {
+    {
+        std::lock_guard lock(lastFrameMutex);
+
+        lastFrame = counters;
+
+        frameNum++;
+    }
+
+    std::memset(&counters, 0, sizeof(Counters));
+}
+
+Counters getLastFrame() {
+    std::lock_guard lock(lastFrameMutex);
+
+    return lastFrame;
+}
+
+u64 getFrameNum() {
+    std::lock_guard lock(lastFrameMutex);
+
+    return frameNum;
+}
+
+const char *getDMAEngineName(const u32 engine) {
+    return DMA_ENGINE_NAMES[engine];
+}
+
+const char *getIODeviceName(const u32 device) {
+    return IO_DEVICE_NAMES[device];
+}
+
+}
@@ -0,0 +1,248 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <plog/Log.h>
+
+namespace sys::trace {
+
+// "S64T"
+constexpr u32 MAGIC = 0x54343653;
+constexpr u32 VERSION = 1;
+
+// Number of records kept per core, older ones are overwritten
+constexpr u64 RING_SIZE = 1 << 20;
+
+struct RingBuffer {
+    std::vector<Record> records;
+
+    // Index of the next record
+    u64 head;
+
+    // Number of records ever written
+    u64 count;
+};
+
+const char *tracePath = NULL;
+
+u32 cores = (1 << Core::NumberOfCores) - 1;
+
+u32 pcStart = 0;
+u32 pcEnd = ~(u32)0;
+
+u64 startFrame = 0;
+u64 frameNum = 0;
+
+bool isEnabled = false;
+bool isPaused = false;
+
+RingBuffer ringBuffers[Core::NumberOfCores];
+
+void setPath(const char *path) {
+    tracePath = path;
+}
+
+void setCores(const u32 coreMask) {
+    cores = coreMask;
+}
+
+bool parseCores(const char *name, u32 &coreMask) {
+    if (std::strcmp(name, "cpu") == 0) {
+        coreMask = 1 << Core::CPU;
+    } else if (std::strcmp(name, "rsp") == 0) {
+        coreMask = 1 << Core::RSP;
+    } else if (std::strcmp(name, "all") == 0) {
+        coreMask = (1 << Core::NumberOfCores) - 1;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void setPCRange(const u32 start, const u32 end) {
+    pcStart = start;
+    pcEnd = end;
+}
+
+bool parsePCRange(const char *spec, u32 &start, u32 &end) {
+    char *next;
+    start = std::strtoul(spec, &next, 16);
+
+    if ((next == spec) || (*next != ':')) {
+        return false;
+    }
+
+    const char *endSpec = next + 1;
+    end = std::strtoul(endSpec, &next, 16);
+
+    return (next != endSpec) && (*next == '\0') && (start <= end);
+}
+
+void setStartFrame(const u64 frame) {
+    startFrame = frame;
+}
+
+// Writes every ring buffer, oldest records first
+void flush() {
+    if (!isEnabled) {
+        return;
+    }
+
+    isEnabled = false;
+
+    FILE *file = std::fopen(tracePath, "wb");
+    if (file == NULL) {
+        PLOG_ERROR << "Unable to open trace file";
+
+        return;
+    }
+
+    const u32 header[] = {MAGIC, VERSION};
+    std::fwrite(header, sizeof(header), 1, file);
+
+    for (u32 core = 0; core < Core::NumberOfCores; core++) {
+        if ((cores & (1 << core)) == 0) {
+            continue;
+        }
+
+        const RingBuffer &ringBuffer = ringBuffers[core];
+
+        const u64 recordNum = std::min(ringBuffer.count, RING_SIZE);
+
+        std::fwrite(&core, sizeof(core), 1, file);
+        std::fwrite(&recordNum, sizeof(recordNum), 1, file);
+
+        // Once the buffer has wrapped, the oldest record is at head
+        const u64 first = (ringBuffer.count > RING_SIZE) ? ringBuffer.head : 0;
+
+        for (u64 i = 0; i < recordNum; i++) {
+            std::fwrite(&ringBuffer.records[(first + i) % RING_SIZE], sizeof(Record), 1, file);
+        }
+    }
+
+    std::fclose(file);
+
+    PLOG_INFO << "Wrote trace to " << tracePath;
+}
+
+void init() {
+    if (tracePath == NULL) {
+        return;
+    }
+
+    for (u32 core = 0; core < Core::NumberOfCores; core++) {
+        if ((cores & (1 << core)) != 0) {
+            ringBuffers[core].records.resize(RING_SIZE);
+        }
+
+        ringBuffers[core].head = 0;
+        ringBuffers[core].count = 0;
+    }
+
+    frameNum = 0;
+
+    isEnabled = true;
+    isPaused = false;
+
+    // Fatal errors exit without going through deinit, and they are what traces are for
+    static bool isAtExitRegistered = false;
+
+    if (!isAtExitRegistered) {
+        std::atexit(flush);
+
+        isAtExitRegistered = true;
+    }
+
+    PLOG_INFO << "Tracing to " << tracePath;
+}
+
+void deinit() {
+    flush();
+
+    for (RingBuffer &ringBuffer : ringBuffers) {
+        ringBuffer.records.clear();
+        ringBuffer.records.shrink_to_fit();
+    }
+}
+
+void toggle() {
+    if (!isEnabled) {
+        return;
+    }
+
+    isPaused = !isPaused;
+
+    PLOG_INFO << "Tracing " << (isPaused ? "paused" : "resumed");
+}
+
+void onFrame() {
+    frameNum++;
+}
+
+bool isActive(const u32 core) {
+    return isEnabled && !isPaused && (frameNum >= startFrame) && ((cores & (1 << core)) != 0);
+}
+
+void record(const u32 core, const u32 pc, const u32 instr, const u64 value) {
+    if ((pc < pcStart) || (pc > pcEnd)) {
+        return;
+    }
+
+    RingBuffer &ringBuffer = ringBuffers[core];
+
+    ringBuffer.records[ringBuffer.head] = Record{pc, instr, value};
+
+    ringBuffer.head = (ringBuffer.head + 1) % RING_SIZE;
+    ringBuffer.count++;
+}
+
+bool read(const char *path, Records &records) {
+    FILE *file = std::fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    for (std::vector<Record> &coreRecords : records) {
+        coreRecords.clear();
+    }
+
+    u32 header[2];
+    if ((std::fread(header, sizeof(header), 1, file) != 1) || (header[0] != MAGIC) || (header[1] != VERSION)) {
+        std::fclose(file);
+
+        return false;
+    }
+
+    u32 core;
+    while (std::fread(&core, sizeof(core), 1, file) == 1) {
+        u64 recordNum;
+        if ((core >= Core::NumberOfCores) || (std::fread(&recordNum, sizeof(recordNum), 1, file) != 1) || (recordNum > RING_SIZE)) {
+            std::fclose(file);
+
+            return false;
+        }
+
+        records[core].resize(recordNum);
+
+        if (std::fread(records[core].data(), sizeof(Record), recordNum, file) != recordNum) {
+            std::fclose(file);
+
+            return false;
+        }
+    }
+
+    std::fclose(file);
+
+    return true;
+}
+
+}
@@ -0,0 +1,207 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+#include "sys/watchpoint.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "hw/cpu/cpu.hpp"
+
+#include "sys/memory.hpp"
+
+namespace sys::watchpoint {
+
+struct Watchpoint {
+    u64 id;
+
+    u64 paddr;
+    u64 size;
+    u32 accessTypes;
+};
+
+std::vector<Watchpoint> watchpoints;
+
+u64 nextID = 0;
+
+bool isInitialized = false;
+
+Callback callback;
+
+bool dumpState = false;
+
+u64 getFirstPage(const Watchpoint &watchpoint) {
+    return memory::addressToPage(watchpoint.paddr);
+}
+
+u64 getLastPage(const Watchpoint &watchpoint) {
+    return memory::addressToPage(watchpoint.paddr + watchpoint.size - 1);
+}
+
+void watchPages(const Watchpoint &watchpoint) {
+    for (u64 page = getFirstPage(watchpoint); page <= getLastPage(watchpoint); page++) {
+        memory::watchPage(page);
+    }
+}
+
+void unwatchPages(const Watchpoint &watchpoint) {
+    for (u64 page = getFirstPage(watchpoint); page <= getLastPage(watchpoint); page++) {
+        // Pages can be shared with other watchpoints
+        const bool isShared = std::any_of(watchpoints.begin(), watchpoints.end(), [page](const Watchpoint &other) {
+            return (page >= getFirstPage(other)) && (page <= getLastPage(other));
+        });
+
+        if (!isShared) {
+            memory::unwatchPage(page);
+        }
+    }
+}
+
+void init() {
+    for (const Watchpoint &watchpoint : watchpoints) {
+        watchPages(watchpoint);
+    }
+
+    isInitialized = true;
+}
+
+void deinit() {
+    watchpoints.clear();
+
+    isInitialized = false;
+}
+
+u64 add(const u64 paddr, const u64 size, const u32 accessTypes) {
+    const Watchpoint watchpoint = {nextID++, paddr, std::max(size, (u64)1), accessTypes};
+
+    watchpoints.push_back(watchpoint);
+
+    if (isInitialized) {
+        watchPages(watchpoint);
+    }
+
+    return watchpoint.id;
+}
+
+void remove(const u64 id) {
+    const auto it = std::find_if(watchpoints.begin(), watchpoints.end(), [id](const Watchpoint &watchpoint) {
+        return watchpoint.id == id;
+    });
+
+    if (it == watchpoints.end()) {
+        return;
+    }
+
+    const Watchpoint watchpoint = *it;
+
+    watchpoints.erase(it);
+
+    if (isInitialized) {
+        unwatchPages(watchpoint);
+    }
+}
+
+bool parseWatchpoint(const char *spec, u64 &paddr, u64 &size, u32 &accessTypes) {
+    accessTypes = 0;
+
+    for (; (*spec != ':') && (*spec != '\0'); spec++) {
+        switch (*spec) {
+            case 'r':
+                accessTypes |= AccessType::Read;
+                break;
+            case 'w':
+                accessTypes |= AccessType::Write;
+                break;
+            case 'x':
+                accessTypes |= AccessType::Execute;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if ((accessTypes == 0) || (*spec++ != ':')) {
+        return false;
+    }
+
+    char *end;
+    const u64 addr = std::strtoull(spec, &end, 16);
+
+    if (end == spec) {
+        return false;
+    }
+
+    size = 4;
+
+    if (*end == ':') {
+        spec = end + 1;
+        size = std::strtoull(spec, &end, 0);
+
+        if ((end == spec) || (size == 0)) {
+            return false;
+        }
+    }
+
+    if (*end != '\0') {
+        return false;
+    }
+
+    // Accept KSEG0/KSEG1 addresses as well
+    paddr = addr & (hw::cpu::AddressRangeSize::KSEG0 - 1);
+
+    return memory::isValidPhysicalAddress(paddr + size - 1);
+}
+
+void setCallback(const Callback func) {
+    callback = func;
+}
+
+void setDumpState(const bool isEnabled) {
+    dumpState = isEnabled;
+}
+
+void printHit(const Hit &hit) {
+    const char *accessName = "execute";
+    if (hit.accessType == AccessType::Read) {
+        accessName = "read";
+    } else if (hit.accessType == AccessType::Write) {
+        accessName = "write";
+    }
+
+    std::printf(
+        "Watchpoint %" PRIu64 ": %s%" PRIu64 " at %08" PRIX64 " (PC = %016" PRIX64 ")\n",
+        hit.id, accessName, 8 * hit.size, hit.paddr, hit.pc
+    );
+}
+
+void check(const u64 paddr, const u64 size, const u32 accessType) {
+    for (const Watchpoint &watchpoint : watchpoints) {
+        if ((watchpoint.accessTypes & accessType) == 0) {
+            continue;
+        }
+
+        if (((paddr + size) <= watchpoint.paddr) || (paddr >= (watchpoint.paddr + watchpoint.size))) {
+            continue;
+        }
+
+        const Hit hit = {watchpoint.id, paddr, size, accessType, hw::cpu::getCurrentPC()};
+
+        if (callback) {
+            callback(hit);
+        } else {
+            printHit(hit);
+        }
+
+        if (dumpState) {
+            hw::cpu::dumpState();
+        }
+    }
+}
+
+}
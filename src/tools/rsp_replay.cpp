@@ -0,0 +1,195 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+// Re-runs RSP tasks captured with --rsp-capture without a CPU or RDP, checks their outputs
+// and reports how fast the RSP ran them
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <plog/Init.h>
+#include <plog/Log.h>
+#include <plog/Formatters/FuncMessageFormatter.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+
+#include "hw/dp.hpp"
+#include "hw/mi.hpp"
+#include "hw/sp.hpp"
+#include "hw/rsp/capture.hpp"
+#include "hw/rsp/rsp.hpp"
+
+#include "sys/memory.hpp"
+#include "sys/scheduler.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+using hw::rsp::capture::Output;
+using hw::rsp::capture::Task;
+
+constexpr i64 RUN_CYCLES = 2048;
+
+// Tasks that run longer than this are assumed to be stuck
+constexpr i64 MAX_TASK_INSTRUCTIONS = 1ll << 32;
+
+void printUsage() {
+    std::printf("Usage: satou64_rsp_replay [path to RSP capture]\n");
+}
+
+// Returns true if the replayed task produced the same outputs as the captured one
+bool verifyTask(const u64 taskIndex, const Task &expected, const Task &actual) {
+    const u64 outputNum = std::min(expected.outputs.size(), actual.outputs.size());
+
+    for (u64 i = 0; i < outputNum; i++) {
+        const Output &e = expected.outputs[i];
+        const Output &a = actual.outputs[i];
+
+        if ((e.type != a.type) || (e.addr != a.addr) || (e.size != a.size) || (e.hash != a.hash)) {
+            const char *typeName = (e.type == hw::rsp::capture::OutputType::DMAToRAM) ? "DMA to RDRAM" : "DP command list";
+
+            std::printf(
+                "Task %" PRIu64 ": output %" PRIu64 " (%s, address = %06" PRIX64 ", size = %" PRIu64 ") differs\n",
+                taskIndex, i, typeName, e.addr, e.size
+            );
+
+            return false;
+        }
+    }
+
+    if (expected.outputs.size() != actual.outputs.size()) {
+        std::printf(
+            "Task %" PRIu64 ": %zu outputs, expected %zu\n",
+            taskIndex, actual.outputs.size(), expected.outputs.size()
+        );
+
+        return false;
+    }
+
+    if (expected.dmem != actual.dmem) {
+        const auto mismatch = std::mismatch(expected.dmem.begin(), expected.dmem.end(), actual.dmem.begin());
+
+        std::printf(
+            "Task %" PRIu64 ": DMEM differs at %03zX\n",
+            taskIndex, (size_t)(mismatch.first - expected.dmem.begin())
+        );
+
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // Initialize logger
+    static plog::ColorConsoleAppender<plog::FuncMessageFormatter> consoleAppender;
+    plog::init(plog::fatal, &consoleAppender);
+
+    if (argc != 2) {
+        printUsage();
+
+        return -1;
+    }
+
+    FILE *file = std::fopen(argv[1], "rb");
+    if (file == NULL) {
+        std::printf("Unable to open %s\n", argv[1]);
+
+        return -1;
+    }
+
+    if (!hw::rsp::capture::readHeader(file)) {
+        std::printf("%s is not an RSP capture of this version\n", argv[1]);
+
+        std::fclose(file);
+
+        return -1;
+    }
+
+    // Only what the RSP can reach
+    sys::memory::init(NULL, NULL);
+    sys::scheduler::init();
+
+    hw::dp::init();
+    hw::mi::init();
+    hw::sp::init();
+    hw::rsp::init();
+
+    sys::memory::reset();
+    sys::scheduler::reset();
+
+    hw::dp::reset();
+    hw::mi::reset();
+    hw::sp::reset();
+    hw::rsp::reset();
+
+    u64 taskNum = 0;
+    u64 failedTaskNum = 0;
+
+    u64 instructions = 0;
+
+    Clock::duration runTime = Clock::duration::zero();
+
+    Task task;
+    while (hw::rsp::capture::readTask(file, task)) {
+        const u64 taskIndex = taskNum++;
+
+        if (!hw::rsp::capture::startReplay(task)) {
+            std::printf("Task %" PRIu64 ": corrupt state\n", taskIndex);
+
+            failedTaskNum++;
+            continue;
+        }
+
+        i64 taskInstructions = 0;
+
+        const auto startTime = Clock::now();
+
+        while (!hw::sp::isHalted() && (taskInstructions < MAX_TASK_INSTRUCTIONS)) {
+            taskInstructions += hw::rsp::run(RUN_CYCLES);
+
+            // The RSP runs at half the scheduler's clock
+            sys::scheduler::run(2 * RUN_CYCLES);
+        }
+
+        runTime += Clock::now() - startTime;
+
+        instructions += taskInstructions;
+
+        if (!hw::sp::isHalted()) {
+            std::printf("Task %" PRIu64 ": didn't halt\n", taskIndex);
+
+            failedTaskNum++;
+            continue;
+        }
+
+        if (!verifyTask(taskIndex, task, hw::rsp::capture::getReplayResult())) {
+            failedTaskNum++;
+        }
+    }
+
+    std::fclose(file);
+
+    const double seconds = std::chrono::duration<double>(runTime).count();
+
+    std::printf("%" PRIu64 " tasks, %" PRIu64 " failed\n", taskNum, failedTaskNum);
+    std::printf(
+        "%" PRIu64 " instructions in %.3f s (%.2f MIPS)\n",
+        instructions, seconds, (seconds > 0) ? (instructions / seconds / 1e6) : 0.0
+    );
+
+    hw::rsp::capture::deinit();
+
+    hw::dp::deinit();
+    hw::mi::deinit();
+    hw::sp::deinit();
+    hw::rsp::deinit();
+
+    sys::memory::deinit();
+    sys::scheduler::deinit();
+
+    return (failedTaskNum == 0) ? 0 : 1;
+}
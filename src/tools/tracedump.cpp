@@ -0,0 +1,123 @@
+/*
+ * Satou64 is a Nintendo 64 emulator written in C++.
+ * Copyright (C) 2024  noumidev
+ */
+
+// Disassembles instruction traces recorded with --trace
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "hw/cpu/disassembler.hpp"
+#include "hw/rsp/disassembler.hpp"
+
+#include "sys/trace.hpp"
+
+using sys::trace::Core::CPU;
+using sys::trace::Core::RSP;
+
+void printUsage() {
+    std::printf("Usage: satou64_tracedump [options] [path to trace]\n");
+    std::printf("Options:\n");
+    std::printf("  --core C  Only print one core (cpu, rsp, all)\n");
+    std::printf("  --last N  Only print the last N records of every core\n");
+}
+
+void dumpCPU(const sys::trace::Record &record) {
+    // Traces only keep the low 32 bits, which are sign-extended in 32-bit mode
+    const u64 pc = (u64)(i64)(i32)record.pc;
+
+    const std::string disasm = hw::cpu::disassembler::disassemble(pc, record.instr);
+
+    std::printf("[CPU] %08X: %08X  ", record.pc, record.instr);
+
+    const int dest = hw::cpu::disassembler::getDestinationRegister(record.instr);
+
+    if (dest >= 0) {
+        std::printf("%-40s ; %s = %016" PRIX64 "\n", disasm.c_str(), hw::cpu::disassembler::getRegisterName(dest), record.value);
+    } else {
+        std::printf("%s\n", disasm.c_str());
+    }
+}
+
+void dumpRSP(const sys::trace::Record &record) {
+    const std::string disasm = hw::rsp::disassembler::disassemble(record.pc, record.instr);
+
+    std::printf("[RSP] %03X: %08X  ", record.pc, record.instr);
+
+    const int dest = hw::rsp::disassembler::getDestinationRegister(record.instr);
+
+    if (dest >= 0) {
+        std::printf("%-40s ; %s = %08X\n", disasm.c_str(), hw::cpu::disassembler::getRegisterName(dest), (u32)record.value);
+    } else {
+        std::printf("%s\n", disasm.c_str());
+    }
+}
+
+int main(int argc, char **argv) {
+    u32 coreMask = (1 << sys::trace::Core::NumberOfCores) - 1;
+
+    u64 lastNum = ~(u64)0;
+
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--core") == 0) && ((i + 1) < argc)) {
+            if (!sys::trace::parseCores(argv[++i], coreMask)) {
+                printUsage();
+
+                return -1;
+            }
+        } else if ((std::strcmp(argv[i], "--last") == 0) && ((i + 1) < argc)) {
+            char *end;
+            lastNum = std::strtoull(argv[++i], &end, 10);
+
+            if (*end != '\0') {
+                printUsage();
+
+                return -1;
+            }
+        } else if ((path == NULL) && (std::strncmp(argv[i], "--", 2) != 0)) {
+            path = argv[i];
+        } else {
+            printUsage();
+
+            return -1;
+        }
+    }
+
+    if (path == NULL) {
+        printUsage();
+
+        return -1;
+    }
+
+    sys::trace::Records records;
+    if (!sys::trace::read(path, records)) {
+        std::printf("%s is not a trace of this version\n", path);
+
+        return -1;
+    }
+
+    for (u32 core = 0; core < sys::trace::Core::NumberOfCores; core++) {
+        if ((coreMask & (1 << core)) == 0) {
+            continue;
+        }
+
+        const std::vector<sys::trace::Record> &coreRecords = records[core];
+
+        const u64 first = (coreRecords.size() > lastNum) ? (coreRecords.size() - lastNum) : 0;
+
+        for (u64 i = first; i < coreRecords.size(); i++) {
+            if (core == CPU) {
+                dumpCPU(coreRecords[i]);
+            } else if (core == RSP) {
+                dumpRSP(coreRecords[i]);
+            }
+        }
+    }
+
+    return 0;
+}